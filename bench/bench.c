@@ -0,0 +1,71 @@
+// Microbenchmarks for the core hot paths and the curses panels
+// Usage: tetty_bench [prefix]... runs only benchmarks whose names start with
+// one of the prefixes
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "timing.h"
+
+// Each measurement runs for at least this long, the best of BENCH_REPS is kept
+#define BENCH_MIN_NS (50 * NS_PER_MS)
+#define BENCH_REPS 5
+
+static int filter_c;
+static char **filter_v;
+static volatile long sink;
+
+void bench_sink(long v) {
+    sink += v;
+}
+
+static int selected(const char *name) {
+    if (!filter_c)
+        return 1;
+    for (int i = 0; i < filter_c; i++)
+        if (!strncmp(name, filter_v[i], strlen(filter_v[i])))
+            return 1;
+    return 0;
+}
+
+void bench_run(const char *name, BenchFn fn, void *ctx) {
+    if (!selected(name))
+        return;
+
+    // Calibrate to a batch long enough for the clock to be noise
+    long iters = 1;
+    uint64_t elapsed = 0;
+    while (1) {
+        uint64_t start = get_ns();
+        fn(ctx, iters);
+        elapsed = get_ns() - start;
+        if (elapsed >= BENCH_MIN_NS)
+            break;
+        iters *= elapsed < BENCH_MIN_NS / 16 ? 8 : 2;
+    }
+
+    uint64_t best = elapsed;
+    for (int i = 1; i < BENCH_REPS; i++) {
+        uint64_t start = get_ns();
+        fn(ctx, iters);
+        elapsed = get_ns() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    printf("%-24s %12.3f %12ld\n", name, (double) best / iters, iters);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    filter_c = argc - 1;
+    filter_v = argv + 1;
+
+    printf("# name ns/op iterations\n");
+    bench_collide();
+    bench_core();
+    bench_draw();
+    bench_pc();
+    bench_input();
+    bench_history();
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// A benchmark body runs its operation iters times
+typedef void (*BenchFn)(void *ctx, long iters);
+
+// Results go to stdout as one line per benchmark:
+//   <name> <ns per op> <iterations>
+// Names are stable between releases so runs can be diffed
+void bench_run(const char *name, BenchFn fn, void *ctx);
+
+// Stores a result somewhere the optimiser cannot see through
+void bench_sink(long v);
+
+void bench_collide();
+
+void bench_core();
+
+void bench_draw();
+
+void bench_pc();
+
+void bench_input();
+
+void bench_history();
+
+#endif
@@ -0,0 +1,108 @@
+// Collision probe cost: the original per-mino cell lookup, the per-row mask
+// loop and the generated collide_masks table, over the same boards and probes
+#include <stdlib.h>
+#include "bench.h"
+#include "board.h"
+
+#define BOARDS 64
+#define PROBES 4096
+
+typedef struct Probe {
+    int8_t x;
+    int8_t y;
+    int8_t type;
+    int8_t rot;
+} Probe;
+
+static int8_t cells[BOARDS][ARR_HEIGHT][BOARD_WIDTH];
+static Board boards[BOARDS];
+static Probe probes[PROBES];
+
+// Before: bounds check and byte load per mino
+static int8_t collide_cells(int8_t board[ARR_HEIGHT][BOARD_WIDTH], int8_t x, int8_t y, int8_t type, int8_t rot) {
+    for (int i = 0; i < 4; i++) {
+        int minoY = y - pieces[type][rot][i][1];
+        int minoX = x + pieces[type][rot][i][0];
+        if (minoY >= ARR_HEIGHT
+          || minoX >= BOARD_WIDTH
+          || minoX < 0
+          || minoY < 0
+          || board[minoY][minoX])
+            return 1;
+    }
+    return 0;
+}
+
+// Row masks computed per probe and compared one mino at a time
+static int8_t collide_rows(Board *board, int8_t x, int8_t y, int8_t type, int8_t rot) {
+    for (int i = 0; i < 4; i++) {
+        int minoY = y - pieces[type][rot][i][1];
+        int minoX = x + pieces[type][rot][i][0];
+        if (minoY >= ARR_HEIGHT
+          || minoX >= BOARD_WIDTH
+          || minoX < 0
+          || minoY < 0
+          || board->rows[minoY] & (1 << minoX))
+            return 1;
+    }
+    return 0;
+}
+
+static void setup() {
+    srandom(1);
+    for (int b = 0; b < BOARDS; b++) {
+        int height = random() % 16;
+        for (int8_t i = 0; i < height; i++) {
+            int8_t hole = random() % BOARD_WIDTH;
+            for (int8_t j = 0; j < BOARD_WIDTH; j++) {
+                if (j == hole || random() % 8 == 0)
+                    continue;
+                cells[b][i][j] = 1;
+                boards[b].rows[i] |= 1 << j;
+            }
+        }
+    }
+    for (int i = 0; i < PROBES; i++) {
+        probes[i].x = random() % (BOARD_WIDTH + 4) - 2;
+        probes[i].y = random() % (BOARD_HEIGHT + 2) - 1;
+        probes[i].type = random() % BAG_SZ;
+        probes[i].rot = random() % 4;
+    }
+}
+
+static void run_cells(void *ctx, long iters) {
+    (void) ctx;
+    long hits = 0;
+    for (long i = 0; i < iters; i++) {
+        Probe *p = &probes[i % PROBES];
+        hits += collide_cells(cells[(i / PROBES) % BOARDS], p->x, p->y, p->type, p->rot);
+    }
+    bench_sink(hits);
+}
+
+static void run_rows(void *ctx, long iters) {
+    (void) ctx;
+    long hits = 0;
+    for (long i = 0; i < iters; i++) {
+        Probe *p = &probes[i % PROBES];
+        hits += collide_rows(&boards[(i / PROBES) % BOARDS], p->x, p->y, p->type, p->rot);
+    }
+    bench_sink(hits);
+}
+
+static void run_table(void *ctx, long iters) {
+    (void) ctx;
+    long hits = 0;
+    for (long i = 0; i < iters; i++) {
+        Probe *p = &probes[i % PROBES];
+        hits += check_collide(&boards[(i / PROBES) % BOARDS], p->x, p->y, p->type, p->rot);
+    }
+    bench_sink(hits);
+}
+
+void bench_collide() {
+    setup();
+    bench_run("collide/cells", run_cells, NULL);
+    bench_run("collide/rows", run_rows, NULL);
+    bench_run("collide/table", run_table, NULL);
+}
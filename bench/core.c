@@ -0,0 +1,228 @@
+// Core hot paths: movement, rotation including kick chains that fail all the
+// way through, line clears, the queue and finesse checks
+#include <string.h>
+#include "bench.h"
+#include "core.h"
+#include "timing.h"
+
+typedef struct SpinCtx {
+    Board board;
+    Piece piece;
+    int8_t spin;
+} SpinCtx;
+
+typedef struct ClearCtx {
+    Board board;
+} ClearCtx;
+
+typedef struct FinesseCtx {
+    Board board;
+    Piece placed;
+} FinesseCtx;
+
+static Board stack;
+
+// Ten rows of garbage with one hole each, the usual mid-game surface
+static void make_stack(Board *b, int8_t height) {
+    memset(b, 0, sizeof(*b));
+    for (int8_t i = 0; i < height; i++) {
+        b->rows[i] = FULL_ROW & ~(1 << ((i * 3) % BOARD_WIDTH));
+        memset(b->colors[i], 8, BOARD_WIDTH);
+    }
+}
+
+static void run_move_drop(void *ctx, long iters) {
+    (void) ctx;
+    Piece p;
+    long y = 0;
+    for (long i = 0; i < iters; i++) {
+        gen_piece(&p, i % BAG_SZ);
+        move_piece(&stack, &p, 0, -p.y);
+        y += p.y;
+    }
+    bench_sink(y);
+}
+
+static void run_move_das(void *ctx, long iters) {
+    (void) ctx;
+    Piece p;
+    gen_piece(&p, 5);
+    for (long i = 0; i < iters; i++)
+        move_piece(&stack, &p, 1, (i & 1) ? BOARD_WIDTH : -BOARD_WIDTH);
+    bench_sink(p.x);
+}
+
+static void run_move_step(void *ctx, long iters) {
+    (void) ctx;
+    Piece p;
+    gen_piece(&p, 5);
+    for (long i = 0; i < iters; i++)
+        move_piece(&stack, &p, 1, (i & 2) ? 1 : -1);
+    bench_sink(p.x);
+}
+
+static void run_spin(void *ctx, long iters) {
+    SpinCtx *c = ctx;
+    Piece p = c->piece;
+    for (long i = 0; i < iters; i++)
+        spin_piece(&c->board, &p, c->spin);
+    bench_sink(p.rot);
+}
+
+// Fills every cell except the ones the piece sits on, so every kick fails
+static void enclose(SpinCtx *c, int8_t type, int8_t spin) {
+    gen_piece(&c->piece, type);
+    c->piece.y = 10;
+    move_piece(&c->board, &c->piece, 0, 0);
+    for (int8_t i = 0; i < ARR_HEIGHT; i++)
+        c->board.rows[i] = FULL_ROW;
+    for (int8_t i = 0; i < 4; i++)
+        c->board.rows[c->piece.coords[i][1]] &= ~(1 << c->piece.coords[i][0]);
+    c->spin = spin;
+}
+
+static void run_clear(void *ctx, long iters) {
+    ClearCtx *c = ctx;
+    Board b;
+    long cleared = 0;
+    for (long i = 0; i < iters; i++) {
+        memcpy(&b, &c->board, sizeof(b));
+        cleared += clear_lines(&b);
+    }
+    bench_sink(cleared);
+}
+
+static void run_queue_pop(void *ctx, long iters) {
+    (void) ctx;
+    int8_t queue[BAG_SZ];
+    int8_t pos = 0;
+    Piece p;
+    uint64_t rng = 1;
+    queue_init(queue, &rng);
+    for (long i = 0; i < iters; i++)
+        pos = queue_pop(&p, queue, pos, &rng);
+    bench_sink(pos);
+}
+
+static void run_finesse(void *ctx, long iters) {
+    FinesseCtx *c = ctx;
+    Finesse f;
+    long len = 0;
+    for (long i = 0; i < iters; i++)
+        len += finesse_check(&c->board, &c->placed, &f);
+    bench_sink(len);
+}
+
+// Drops type in rot at column x onto board, as the game would lock it
+static void place(FinesseCtx *c, int8_t type, int8_t rot, int8_t x) {
+    gen_piece(&c->placed, type);
+    c->placed.rot = rot;
+    c->placed.x = x;
+    move_piece(&c->board, &c->placed, 0, -c->placed.y);
+}
+
+// Whole pieces through the core: spawn, shift, rotate, hard drop, clear
+static void run_core_piece(void *ctx, long iters) {
+    Config *config = ctx;
+    GameState s;
+    uint64_t t = 0;
+    core_init(&s, config, 1);
+    core_start(&s);
+    for (long i = 0; i < iters; i++) {
+        if (s.pieces == 40 || s.done) {
+            core_init(&s, config, i);
+            core_start(&s);
+            t = 0;
+        }
+        int8_t key = (i & 1) ? LEFT : RIGHT;
+        core_input(&s, key, 1, t += 1000);
+        core_input(&s, key, 0, t += 1000);
+        core_input(&s, CW, 1, t += 1000);
+        core_input(&s, CW, 0, t += 1000);
+        core_input(&s, HD, 1, t += 1000);
+        core_input(&s, HD, 0, t += 1000);
+    }
+    bench_sink(s.pieces);
+}
+
+// Frames of the same input stream at each gravity: auto-shift to one wall,
+// then the other, then a hard drop twice a second, with lock delay on
+static void run_core_frame(void *ctx, long iters) {
+    Config *config = ctx;
+    GameState s;
+    core_init(&s, config, 1);
+    core_start(&s);
+    for (long i = 0; i < iters; i++) {
+        if (s.pieces == 10 || s.done) {
+            core_init(&s, config, i);
+            core_start(&s);
+        }
+        int phase = i % 30;
+        uint16_t inputs = phase < 10 ? 1 << LEFT : phase < 20 ? 1 << RIGHT : 0;
+        if (phase == 29)
+            inputs |= 1 << HD;
+        core_step(&s, inputs);
+    }
+    bench_sink(s.pieces);
+}
+
+void bench_core() {
+    make_stack(&stack, 10);
+    bench_run("move/drop", run_move_drop, NULL);
+    bench_run("move/das", run_move_das, NULL);
+    bench_run("move/step", run_move_step, NULL);
+
+    static SpinCtx spin;
+    memset(&spin, 0, sizeof(spin));
+    gen_piece(&spin.piece, 5);
+    spin.spin = 0;
+    bench_run("spin/cw", run_spin, &spin);
+    spin.spin = 1;
+    bench_run("spin/180", run_spin, &spin);
+
+    enclose(&spin, 5, 0);
+    bench_run("spin/cw_kicks_fail", run_spin, &spin);
+    enclose(&spin, 0, 0);
+    bench_run("spin/i_cw_kicks_fail", run_spin, &spin);
+    enclose(&spin, 5, 1);
+    bench_run("spin/180_kicks_fail", run_spin, &spin);
+
+    static ClearCtx clear;
+    const char *clear_names[] = { "clear/0", "clear/1", "clear/2", "clear/3", "clear/4" };
+    for (int8_t n = 0; n <= 4; n++) {
+        make_stack(&clear.board, 10);
+        // Full rows interleaved with the garbage, so the compaction moves rows
+        for (int8_t i = 0; i < n; i++)
+            clear.board.rows[1 + i * 2] = FULL_ROW;
+        bench_run(clear_names[n], run_clear, &clear);
+    }
+
+    bench_run("queue/pop", run_queue_pop, NULL);
+
+    // Low stack uses the generated moves, a tall one needs a search, and a
+    // tuck under an overhang only shows up once soft drop is allowed
+    static FinesseCtx fin;
+    make_stack(&fin.board, 10);
+    place(&fin, 5, 1, 0);
+    bench_run("finesse/memo", run_finesse, &fin);
+    make_stack(&fin.board, 17);
+    place(&fin, 5, 1, 0);
+    bench_run("finesse/search", run_finesse, &fin);
+    memset(&fin.board, 0, sizeof(fin.board));
+    fin.board.rows[2] = 0xf;
+    gen_piece(&fin.placed, 3);
+    move_piece(&fin.board, &fin.placed, 0, -fin.placed.y);
+    move_piece(&fin.board, &fin.placed, 1, -BOARD_WIDTH);
+    bench_run("finesse/soft_drop", run_finesse, &fin);
+
+    static Config config = { .das = 100, .arr = 0, .sdf = 0 };
+    bench_run("core/piece", run_core_piece, &config);
+
+    static Config frame = { .das = 100, .arr = 0, .sdf = 0, .lock = 500, .lock_resets = 15, .level = 1 };
+    bench_run("core/frame/sprint", run_core_frame, &frame);
+    frame.levels = 1;
+    frame.gravity[0] = NS_PER_SEC / (5 * FPS);
+    bench_run("core/frame/5g", run_core_frame, &frame);
+    frame.gravity[0] = 0;
+    bench_run("core/frame/20g", run_core_frame, &frame);
+}
@@ -0,0 +1,146 @@
+// Panel rendering into a curses screen whose output goes to /dev/null
+// draw/* forces a full redraw and flush every op, draw/*_same repeats
+// unchanged inputs and measures the damage tracking skip, ansi/* is the
+// forced redraw through the ANSI renderer
+#include <curses.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench.h"
+#include "core.h"
+#include "draw.h"
+
+typedef struct DrawCtx {
+    Panel panel;
+    GameState state;
+    uint16_t inputs;
+    int8_t force;
+} DrawCtx;
+
+static void run_board(void *ctx, long iters) {
+    DrawCtx *c = ctx;
+    for (long i = 0; i < iters; i++) {
+        c->panel.valid = !c->force;
+        draw_board(&c->panel, &c->state.board, &c->state.curr, CLEAR_GOAL - c->state.cleared, 0);
+        draw_flush();
+    }
+}
+
+static void run_queue(void *ctx, long iters) {
+    DrawCtx *c = ctx;
+    for (long i = 0; i < iters; i++) {
+        c->panel.valid = !c->force;
+        draw_queue(&c->panel, c->state.queue, c->state.queue_pos);
+        draw_flush();
+    }
+}
+
+static void run_hold(void *ctx, long iters) {
+    DrawCtx *c = ctx;
+    for (long i = 0; i < iters; i++) {
+        c->panel.valid = !c->force;
+        draw_hold(&c->panel, c->state.hold, c->state.hold_used);
+        draw_flush();
+    }
+}
+
+static void run_keys(void *ctx, long iters) {
+    DrawCtx *c = ctx;
+    for (long i = 0; i < iters; i++) {
+        c->panel.valid = !c->force;
+        draw_keys(&c->panel, c->inputs);
+        draw_flush();
+    }
+}
+
+static void run_stats(void *ctx, long iters) {
+    DrawCtx *c = ctx;
+    for (long i = 0; i < iters; i++) {
+        c->panel.valid = !c->force;
+        draw_stats(&c->panel, 83450000000ULL, 100, 312, 7, NULL);
+        draw_flush();
+    }
+}
+
+static void run_panel(const char *name, const char *same, BenchFn fn, DrawCtx *c) {
+    c->force = 1;
+    bench_run(name, fn, c);
+    c->force = 0;
+    bench_run(same, fn, c);
+}
+
+void bench_draw() {
+    FILE *out = fopen("/dev/null", "w");
+    FILE *in = fopen("/dev/null", "r");
+    if (!out || !in)
+        return;
+    SCREEN *screen = newterm(getenv("TERM") ? NULL : "xterm-256color", out, in);
+    if (!screen)
+        return;
+    set_term(screen);
+    init_curses_colors();
+
+    static DrawCtx c;
+    static Config config = { .das = 100 };
+    core_init(&c.state, &config, 1);
+    core_start(&c.state);
+    // Mid-game looking board
+    for (int8_t i = 0; i < 8; i++) {
+        c.state.board.rows[i] = FULL_ROW & ~(1 << (i % BOARD_WIDTH));
+        for (int8_t j = 0; j < BOARD_WIDTH; j++)
+            c.state.board.colors[i][j] = 1 + (i + j) % BAG_SZ;
+    }
+    c.state.hold = 2;
+    c.inputs = 1 << LEFT | 1 << HD;
+
+    panel_init(&c.panel, BOARD_HEIGHT, BOARD_WIDTH * 2, 0, 0);
+    run_panel("draw/board", "draw/board_same", run_board, &c);
+    panel_free(&c.panel);
+
+    panel_init(&c.panel, 15, 4 * 2, 0, 0);
+    run_panel("draw/queue", "draw/queue_same", run_queue, &c);
+    panel_free(&c.panel);
+
+    panel_init(&c.panel, 2, 4 * 2, 0, 0);
+    run_panel("draw/hold", "draw/hold_same", run_hold, &c);
+    panel_free(&c.panel);
+
+    panel_init(&c.panel, 7, 38, 0, 0);
+    run_panel("draw/keys", "draw/keys_same", run_keys, &c);
+    panel_free(&c.panel);
+
+    panel_init(&c.panel, 5, 14, 0, 0);
+    run_panel("draw/stats", "draw/stats_same", run_stats, &c);
+    panel_free(&c.panel);
+
+    // The same forced redraws, curses and the ANSI renderer both diff
+    // against what they last sent so neither writes anything here
+    int fd = open("/dev/null", O_WRONLY);
+    AnsiScreen ansi;
+    if (fd >= 0 && !ansi_init(&ansi, fd, LINES, COLS)) {
+        draw_use_ansi(&ansi);
+        c.force = 1;
+
+        panel_init(&c.panel, BOARD_HEIGHT, BOARD_WIDTH * 2, 0, 0);
+        bench_run("ansi/board", run_board, &c);
+        panel_init(&c.panel, 15, 4 * 2, 0, 0);
+        bench_run("ansi/queue", run_queue, &c);
+        panel_init(&c.panel, 2, 4 * 2, 0, 0);
+        bench_run("ansi/hold", run_hold, &c);
+        panel_init(&c.panel, 7, 38, 0, 0);
+        bench_run("ansi/keys", run_keys, &c);
+        panel_init(&c.panel, 5, 14, 0, 0);
+        bench_run("ansi/stats", run_stats, &c);
+
+        draw_use_ansi(NULL);
+        ansi_free(&ansi);
+    }
+    if (fd >= 0)
+        close(fd);
+
+    endwin();
+    delscreen(screen);
+    fclose(out);
+    fclose(in);
+}
@@ -0,0 +1,79 @@
+// Run history with a few years of play behind it: history/stats is the per
+// frame comparison with the personal best and every other run, history/open
+// maps an index that is already up to date. Neither depends on the number
+// of runs
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+#include "history.h"
+#include "timing.h"
+
+#define RUNS 20000
+
+typedef struct StatsCtx {
+    History h;
+    GameState s;
+} StatsCtx;
+
+typedef struct OpenCtx {
+    char dir[64];
+} OpenCtx;
+
+static void run_stats(void *ctx, long iters) {
+    StatsCtx *c = ctx;
+    HistoryStats hs;
+    long n = 0;
+    for (long i = 0; i < iters; i++) {
+        c->s.n_splits = 1 + (i & (SPLITS - 1));
+        history_stats(&c->h, &c->s, &hs);
+        n += hs.beats;
+    }
+    bench_sink(n);
+}
+
+static void run_open(void *ctx, long iters) {
+    OpenCtx *c = ctx;
+    History h;
+    long n = 0;
+    for (long i = 0; i < iters; i++) {
+        if (!history_open(&h, c->dir)) {
+            n += h.index->runs;
+            history_close(&h);
+        }
+    }
+    bench_sink(n);
+}
+
+void bench_history() {
+    static OpenCtx o;
+    strcpy(o.dir, "/tmp/tetty-bench-XXXXXX");
+    if (!mkdtemp(o.dir))
+        return;
+
+    // Sprints between 25 and 75 seconds with even splits
+    static StatsCtx c;
+    if (!history_open(&c.h, o.dir)) {
+        GameState run = { .done = 1, .n_splits = SPLITS, .pieces = 100, .keys = 300 };
+        srand(1);
+        for (int i = 0; i < RUNS; i++) {
+            run.end_time = (25000 + rand() % 50000) * NS_PER_MS;
+            for (int k = 0; k < SPLITS; k++)
+                run.splits[k] = run.end_time / SPLITS * (k + 1);
+            history_add(&c.h, &run, i);
+        }
+        for (int k = 0; k < SPLITS; k++)
+            c.s.splits[k] = 45000 * NS_PER_MS / SPLITS * (k + 1);
+        bench_run("history/stats", run_stats, &c);
+        history_close(&c.h);
+        bench_run("history/open", run_open, &o);
+    }
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/history", o.dir);
+    unlink(path);
+    strcat(path, ".idx");
+    unlink(path);
+    rmdir(o.dir);
+}
@@ -0,0 +1,71 @@
+// Kitty keyboard protocol decoding: a finger roll of presses, repeats and
+// releases with modifiers, as one read would return it. input/keymap looks
+// up the default kitty bindings plus a second key for each action, half of
+// them through the hash
+#include <string.h>
+#include "bench.h"
+#include "input.h"
+#include "keymap.h"
+
+typedef struct DecodeCtx {
+    char buf[1024];
+    size_t len;
+} DecodeCtx;
+
+static void run_decode(void *ctx, long iters) {
+    DecodeCtx *c = ctx;
+    KeyDecoder d = { 0 };
+    KeyEvent keys[sizeof(c->buf) / 3];
+    long n = 0;
+    for (long i = 0; i < iters; i++)
+        n += key_decode(&d, c->buf, c->len, keys, sizeof(keys) / sizeof(keys[0]));
+    bench_sink(n);
+}
+
+typedef struct KeymapCtx {
+    Keymap map;
+    uint32_t keys[KEYS * 2 + 2];
+} KeymapCtx;
+
+static void run_keymap(void *ctx, long iters) {
+    KeymapCtx *c = ctx;
+    uint64_t down = 0;
+    long n = 0;
+    for (long i = 0; i < iters; i++) {
+        int slot = keymap_slot(&c->map, c->keys[i % (KEYS * 2 + 2)]);
+        if (slot)
+            down ^= 1ull << (slot - 1);
+        n += keymap_actions(&c->map, down);
+    }
+    bench_sink(n);
+}
+
+void bench_input() {
+    static const char *roll[] = {
+        "\e[1;1:1D", "\e[97u", "\e[1;1:3D", "\e[97;1:3u", "\e[57441;2u",
+        "\e[1;2:1C", "\e[1;2:2C", "\e[1;2:3C", "\e[57441;2:3u", "\e[32u",
+        "\e[32;1:3u", "\e[115:83;2u", "\e[115;2:3u", "\e[1;1:1B", "\e[1;1:3B",
+    };
+    static DecodeCtx c;
+    c.len = 0;
+    for (size_t i = 0; i < sizeof(roll) / sizeof(roll[0]); i++) {
+        size_t n = strlen(roll[i]);
+        memcpy(c.buf + c.len, roll[i], n);
+        c.len += n;
+    }
+    bench_run("input/kitty_roll", run_decode, &c);
+
+    static const uint32_t kitty[KEYS] = { 260, 261, 258, ' ', 'a', 's', 'd', 57441, 'r', 'q', 'p' };
+    static KeymapCtx k;
+    keymap_clear(&k.map);
+    for (int i = 0; i < KEYS; i++) {
+        k.keys[2 * i] = kitty[i];
+        k.keys[2 * i + 1] = 57399 + i;
+        keymap_bind(&k.map, kitty[i], i);
+        keymap_bind(&k.map, 57399 + i, i);
+    }
+    // Unbound keys
+    k.keys[KEYS * 2] = 'x';
+    k.keys[KEYS * 2 + 1] = 57450;
+    bench_run("input/keymap", run_keymap, &k);
+}
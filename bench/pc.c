@@ -0,0 +1,45 @@
+// Perfect clear solves: a mid-game board with a clear three rows up, and an
+// opening bag where the whole tree has to be ruled out
+#include <string.h>
+#include "bench.h"
+#include "pc.h"
+
+typedef struct PcCtx {
+    PcSolver solver;
+    PcInput in;
+} PcCtx;
+
+static void run_pc(void *ctx, long iters) {
+    PcCtx *c = ctx;
+    long found = 0;
+    for (long i = 0; i < iters; i++) {
+        PcResult res = { .id = c->solver.request };
+        pc_solve(&c->solver, &c->in, &res);
+        found += res.status == PC_FOUND;
+    }
+    bench_sink(found);
+}
+
+void bench_pc() {
+    static PcCtx c;
+    if (pc_init(&c.solver))
+        return;
+
+    // ####.#...# with S in hand, O held and L T J Z I to come
+    static const int8_t mid[PC_PREVIEW] = { 2, 5, 1, 6, 0 };
+    memset(&c.in, 0, sizeof(c.in));
+    c.in.rows[0] = 0x22f;
+    c.in.curr = 4;
+    c.in.hold = 3;
+    memcpy(c.in.preview, mid, sizeof(mid));
+    bench_run("pc/found", run_pc, &c);
+
+    static const int8_t bag[PC_PREVIEW] = { 1, 2, 3, 4, 5 };
+    memset(&c.in, 0, sizeof(c.in));
+    c.in.curr = 0;
+    c.in.hold = -1;
+    memcpy(c.in.preview, bag, sizeof(bag));
+    bench_run("pc/none", run_pc, &c);
+
+    pc_free(&c.solver);
+}
@@ -0,0 +1,63 @@
+#ifndef ANSI_H
+#define ANSI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Colour pairs, numbered as the curses ones are
+#define ANSI_PAIRS 16
+
+#define ANSI_REVERSE 1
+
+// One terminal cell, its glyph already UTF-8 encoded
+typedef struct AnsiCell {
+    char glyph[4];
+    uint8_t len;
+    uint8_t pair;
+    uint8_t attr;
+} AnsiCell;
+
+// Renders straight to the terminal without curses
+// Frames are drawn into back, front holds what the terminal shows, and a
+// flush sends only the cells that differ with a single write
+typedef struct AnsiScreen {
+    int fd;
+    int rows;
+    int cols;
+    AnsiCell *front;
+    AnsiCell *back;
+    char *out;
+    size_t cap;
+    // SGR parameters for each colour pair, "" for the default colours
+    const char *pairs[ANSI_PAIRS];
+    // Totals over every flush
+    uint64_t bytes;
+    uint64_t writes;
+} AnsiScreen;
+
+int ansi_init(AnsiScreen *scr, int fd, int rows, int cols);
+
+void ansi_free(AnsiScreen *scr);
+
+// Reallocates both grids for a new terminal size and clears, so the next
+// flush redraws everything. The old grids stay if it fails
+int ansi_resize(AnsiScreen *scr, int rows, int cols);
+
+void ansi_pair(AnsiScreen *scr, uint8_t pair, const char *sgr);
+
+// Blanks a rectangle of the back grid, clipped to the screen
+void ansi_fill(AnsiScreen *scr, int y, int x, int h, int w);
+
+// Writes UTF-8 text from (y, x) one code point per cell, stopping before
+// column end or the edge of the screen, and returns the column after it
+int ansi_puts(AnsiScreen *scr, int y, int x, int end, uint8_t pair, uint8_t attr, const char *s);
+
+// Blanks both grids and the terminal, so the next flush only sends what
+// was drawn since
+void ansi_clear(AnsiScreen *scr);
+
+// Sends the differences between back and front, returns the bytes written
+// or -1 on a write error
+long ansi_flush(AnsiScreen *scr);
+
+#endif
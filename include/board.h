@@ -0,0 +1,76 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+#include "pieces.h"
+
+#define BOARD_HEIGHT 20
+#define ARR_HEIGHT 40
+#define BOARD_WIDTH 10
+
+#define SPAWN_X 4
+#define SPAWN_Y 19
+#define SPAWN_ROT 0
+
+#define FULL_ROW ((1 << BOARD_WIDTH) - 1)
+
+// Colour of garbage cells, one past the pieces'
+#define GARBAGE_COLOR (BAG_SZ + 1)
+
+typedef struct Piece {
+    int8_t x;
+    int8_t y;
+    int8_t coords[4][2];
+    uint8_t type;
+    uint8_t rot;
+} Piece;
+
+// Occupancy is kept as one bitmask per row (bit n = column n), colours are
+// only read when drawing
+// The rows past ARR_HEIGHT are always empty so a collision probe can compare
+// four rows at once without a bounds check
+// version is bumped whenever a cell changes so renderers can skip redraws
+typedef struct Board {
+    uint16_t rows[ARR_HEIGHT + 3];
+    int8_t colors[ARR_HEIGHT][BOARD_WIDTH];
+    uint32_t version;
+} Board;
+
+// Collision data for one piece, rotation and centre column
+// rows[0] is the bottom row of the piece, already shifted to its column
+// The piece fits in the matrix for min_y <= y <= max_y, an empty range means
+// that column is out of bounds for this rotation
+typedef struct CollideMask {
+    uint16_t rows[4];
+    int8_t min_y;
+    int8_t max_y;
+    int8_t bottom;
+} CollideMask;
+
+// Generated at build time by tools/gen_masks.c
+extern const CollideMask collide_masks[BAG_SZ][4][BOARD_WIDTH];
+
+int8_t check_collide(Board *board, int8_t x, int8_t y, int8_t type, int8_t rot);
+
+void move_piece(Board *board, Piece *p, int8_t h, int8_t amount);
+
+// Column occupancy, bit y of cols[x] is the cell at (x, y)
+void board_columns(Board *board, uint64_t cols[BOARD_WIDTH]);
+
+// Cells p can fall before it lands, worked out from the highest cell under
+// each of its own in cols rather than by trying each row
+int8_t drop_distance(Board *board, const uint64_t cols[BOARD_WIDTH], Piece *p);
+
+void spin_piece(Board *board, Piece *p, int8_t spin);
+
+void lock_piece(Board *board, Piece *p);
+
+void gen_piece(Piece *p, int8_t type);
+
+int8_t clear_lines(Board *board);
+
+// Pushes the stack up by lines rows of garbage, each full but for column hole
+// Anything pushed past the top of the array is lost
+void add_garbage(Board *board, int8_t lines, int8_t hole);
+
+#endif
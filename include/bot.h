@@ -0,0 +1,109 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "config.h"
+#include "core.h"
+#include "search.h"
+
+// Pieces the bot may look at past the current one, the ones drawn in the queue
+#define BOT_PREVIEW 5
+// Transitions one placement can take: hold, taps to a wall, spins, drops
+#define BOT_MAX_EVENTS 64
+// Distinct landing spots kept per piece
+#define BOT_MAX_LANDINGS 256
+
+typedef struct BotEvent {
+    // Offset from the first transition of the placement
+    uint64_t time;
+    int8_t key;
+    int8_t pressed;
+} BotEvent;
+
+// Key transitions that play one placement
+typedef struct BotMove {
+    BotEvent ev[BOT_MAX_EVENTS];
+    int n;
+} BotMove;
+
+// A board in the beam: where the stack is after some placements and what is
+// left to play
+typedef struct BotNode {
+    uint16_t rows[ARR_HEIGHT + 3];
+    int8_t curr;
+    int8_t hold;
+    // Index of the next piece to come out of the preview
+    int8_t next;
+    // Placement at the root this node descends from
+    int16_t root;
+    int32_t reward;
+    int32_t score;
+    // Of the rows and pieces left, to drop boards the beam already holds
+    uint64_t hash;
+} BotNode;
+
+// First placement of each line the beam follows
+typedef struct BotRoot {
+    int8_t hold;
+    int8_t type;
+    int8_t len;
+    int8_t keys[SEARCH_MAX_PATH];
+} BotRoot;
+
+struct Bot;
+
+typedef struct BotWorker {
+    pthread_t thread;
+    struct Bot *bot;
+} BotWorker;
+
+// Beam search player, each depth of the beam is expanded in parallel by a
+// pool of threads that lives as long as the bot
+typedef struct Bot {
+    int depth;
+    int beam;
+    int32_t holes;
+    int32_t bump;
+    int32_t height;
+    int32_t wells;
+    int32_t clears[5];
+
+    int8_t pieces[BOT_PREVIEW + 1];
+    int8_t n_pieces;
+    int8_t hold_used;
+
+    BotNode *nodes;
+    int n_nodes;
+    BotNode *children;
+    int n_children;
+    int max_children;
+    BotRoot *roots;
+    int n_roots;
+    int max_roots;
+
+    // Work handed to the pool: nodes[0, n_nodes) to expand
+    int8_t at_root;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    uint32_t generation;
+    int next;
+    int busy;
+    int8_t quit;
+    BotWorker *workers;
+    int n_workers;
+} Bot;
+
+// Default search and heuristic settings
+void bot_defaults(Config *config);
+
+int bot_init(Bot *bot, Config *config);
+
+void bot_free(Bot *bot);
+
+// Picks the next placement for the game and the keys that play it
+// Returns 0 if nothing can be placed
+int bot_think(Bot *bot, GameState *s, BotMove *move);
+
+#endif
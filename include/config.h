@@ -1,28 +1,104 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <pthread.h>
 #include <stdint.h>
+#include "keymap.h"
+
+#define KEYS 11
+
+#define LEFT 0
+#define RIGHT 1
+#define SD 2
+#define HD 3
+#define CCW 4
+#define CW 5
+#define FLIP 6
+#define HOLD 7
+#define RESET 8
+#define QUIT 9
+#define SOLVE 10
+
+// Keys that can be bound to one action in each input mode
+#define BINDS 4
 
 enum InputMode {
     EXTKEYS,
     SCANCODES,
-    NORM
+    NORM,
+    // Keyboards read through /dev/input, only tried when asked for
+    EVDEV
 };
 
+#define MODES 4
+
+// Levels the gravity curve can list
+#define LEVELS 32
+
 typedef struct Config {
-    uint32_t left;
-    uint32_t right;
-    uint32_t sd;
-    uint32_t hd;
-    uint32_t ccw;
-    uint32_t cw;
-    uint32_t flip;
-    uint32_t hold;
-    uint32_t reset;
-    uint32_t quit;
+    // Key bindings for every input mode, lists end early at a 0
+    uint32_t binds[MODES][KEYS][BINDS];
+    // The current mode's bindings, compiled
+    Keymap keymap;
+    // Handling, das and arr in ms, sdf as a multiple of gravity (0 = instant)
+    uint32_t das;
+    uint32_t arr;
+    uint32_t sdf;
+    // Time from a reset to the first piece in ms, READY for the first half
+    // and GO! for the second
+    uint32_t countdown;
+    // Lock delay in ms (0 only locks on hard drop) and how many moves on the
+    // ground can restart it
+    uint32_t lock;
+    uint32_t lock_resets;
+    // Level to start at and gravity for each level from 1 in ns per cell,
+    // 0 for 20G. Without any levels gravity is the sprint's GRAVITY
+    uint32_t level;
+    uint32_t gravity[LEVELS];
+    int8_t levels;
+    // Bot search, threads 0 means one per core and pps 0 means as fast as
+    // it can think
+    uint32_t bot_threads;
+    uint32_t bot_depth;
+    uint32_t bot_beam;
+    uint32_t bot_pps;
+    // Bot heuristic, penalties per hole, bumpiness, height and well depth
+    // and rewards for clearing 1 to 4 lines
+    int32_t bot_holes;
+    int32_t bot_bump;
+    int32_t bot_height;
+    int32_t bot_wells;
+    int32_t bot_clears[5];
     enum InputMode mode;
 } Config;
 
 void config_init(Config *config);
 
+// Compiles the bindings for config->mode into config->keymap
+void config_keymap(Config *config);
+
+// Watches the config directory and re-reads config.ini on its own thread
+// whenever it is written or replaced, the game picks the result up with
+// config_reload
+typedef struct ConfigWatch {
+    int fd;
+    // Written to stop the thread
+    int stop[2];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    enum InputMode mode;
+    // Parsed and waiting to be swapped in
+    Config next;
+    int8_t ready;
+} ConfigWatch;
+
+// Returns -1 if the directory can't be watched, the config still works but
+// never reloads
+int config_watch(ConfigWatch *w, Config *config);
+
+// Swaps in the newest parsed config if there is one, returns 1 if it did
+int config_reload(ConfigWatch *w, Config *config);
+
+void config_unwatch(ConfigWatch *w);
+
 #endif
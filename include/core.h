@@ -0,0 +1,143 @@
+#ifndef CORE_H
+#define CORE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "board.h"
+#include "handling.h"
+#include "finesse.h"
+
+#define FPS 60
+#define CLEAR_GOAL 40
+
+// Lines between splits, the last split is the goal
+#define SPLIT_LINES 10
+#define SPLITS (CLEAR_GOAL / SPLIT_LINES)
+
+// Gravity in cells per frame at FPS, when the config has no level curve
+#define GRAVITY 0.02
+
+// Lines per level, and gravity from this many cells per frame up drops
+// pieces straight onto the stack
+#define LEVEL_LINES 10
+#define GRAVITY_20G 20
+
+// Batches of incoming garbage a game can have waiting
+#define GARBAGE_MAX 16
+
+// Continuous movement (auto-shift, soft drop, gravity) is evaluated on this
+// fixed grid and at every input, never at frame times, so a game is a pure
+// function of its seed and timestamped inputs whatever rate it is driven at
+#define CORE_TICK 1000000ULL
+
+// Times handed to the core are truncated to this, so they survive the
+// microsecond encoding of replays exactly
+#define CORE_RES 1000ULL
+
+// Everything one sprint needs, with no terminal dependency
+// Times are nanoseconds since the start of the game
+typedef struct GameState {
+    Board board;
+    Piece curr;
+    int8_t hold;
+    int8_t hold_used;
+    int8_t queue[BAG_SZ];
+    int8_t queue_pos;
+    uint64_t rng;
+
+    Handling handling;
+    // Gravity for each level in ns per cell, 0 for 20G, the last one carries
+    // on past the end. grav_interval is the current level's
+    uint32_t gravity[LEVELS];
+    int8_t levels;
+    int level;
+    uint64_t grav_interval;
+    uint64_t grav_start;
+    uint32_t grav_dropped;
+    // Columns of the stack, rebuilt when a piece locks, and the cells the
+    // current piece can fall, kept up to date whenever it moves so gravity
+    // and soft drop never probe for collisions
+    uint64_t cols[BOARD_WIDTH];
+    int8_t drop;
+
+    // Lock delay, 0 only locks on hard drop. The timer starts when the piece
+    // touches down and moves on the ground restart it, up to lock_resets
+    // times for each new lowest row the piece reaches
+    uint64_t lock_delay;
+    uint32_t lock_resets;
+    uint64_t lock_start;
+    uint32_t resets;
+    int8_t lock_low;
+    int8_t grounded;
+
+    // Held keys, bit n is key n
+    uint16_t inputs;
+    uint64_t time;
+
+    int pieces;
+    int holds;
+    int keys;
+    int keys_tmp;
+
+    // Keys pressed for the current piece and how the last one compared
+    // with the fewest it could have taken
+    int8_t piece_keys;
+    int8_t last_keys;
+    int8_t fault;
+    int faults;
+    Finesse finesse;
+    int cleared;
+    // When each multiple of SPLIT_LINES was reached
+    uint64_t splits[SPLITS];
+    int8_t n_splits;
+    int8_t done;
+    // Versus games end when a piece spawns into the stack, sprints carry on
+    // as they always have so their replays still check out
+    int8_t versus;
+    int8_t topped_out;
+    uint64_t end_time;
+
+    // Versus: lines sent after cancelling, over the whole game, and garbage
+    // waiting to rise, oldest batch first
+    int sent;
+    int8_t garbage[GARBAGE_MAX];
+    int8_t garbage_holes[GARBAGE_MAX];
+    int8_t n_garbage;
+} GameState;
+
+// Seedable generator owned by each game, so games can run side by side
+uint32_t rng_next(uint64_t *rng);
+
+void queue_init(int8_t queue[], uint64_t *rng);
+
+int8_t queue_pop(Piece *p, int8_t queue[], int8_t queue_pos, uint64_t *rng);
+
+// Default handling and game rules, levels 0 means constant GRAVITY
+void core_defaults(Config *config);
+
+// Only the handling and game rules in config are used, the queue is drawn
+// from seed
+void core_init(GameState *s, Config *config, uint32_t seed);
+
+// Spawns the first piece, the queue before this is the full opening bag
+void core_start(GameState *s);
+
+// Runs the simulation up to time
+void core_advance(GameState *s, uint64_t time);
+
+// Applies a key transition that happened at time, which must not be before
+// the last advance
+void core_input(GameState *s, int8_t key, int8_t pressed, uint64_t time);
+
+// Queues lines of garbage with their gap at column hole, they rise after
+// the next piece that doesn't clear
+void core_garbage(GameState *s, int8_t lines, int8_t hole);
+
+// Lines of garbage waiting to rise
+int core_pending(GameState *s);
+
+// Fixed step for headless clients: applies the transitions between the held
+// keys and inputs (bit n = key n), then advances by one frame
+void core_step(GameState *s, uint16_t inputs);
+
+#endif
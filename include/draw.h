@@ -0,0 +1,102 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+#include <curses.h>
+#include <stddef.h>
+#include "ansi.h"
+#include "board.h"
+#include "input.h"
+#include "finesse.h"
+#include "history.h"
+#include "pc.h"
+#include "perf.h"
+#include "versus.h"
+
+#define QUEUE_SZ 5
+
+// Largest key a panel remembers
+#define PANEL_KEY 32
+
+// A window plus the inputs it was last drawn from
+// Draw calls whose inputs match the stored key skip all curses work, and
+// windows that are drawn are only staged with wnoutrefresh, so the caller
+// flushes everything with one draw_flush per frame
+// With the ANSI renderer there is no window, only the rectangle
+typedef struct Panel {
+    WINDOW *w;
+    int y;
+    int x;
+    int h;
+    int cols;
+    uint8_t key[PANEL_KEY];
+    size_t len;
+    int8_t valid;
+} Panel;
+
+void init_curses();
+
+// Colour pairs used by the panels, for screens not set up by init_curses
+void init_curses_colors();
+
+// Draws through scr instead of curses from now on, NULL goes back
+// Panels have to be made after the switch
+void draw_use_ansi(AnsiScreen *scr);
+
+void panel_init(Panel *panel, int h, int w, int y, int x);
+
+void panel_free(Panel *panel);
+
+// Blanks the panel, which then redraws on its next draw call whatever the key
+void panel_blank(Panel *panel);
+
+// Returns 1 and stores key if it differs from what the panel last drew
+// A key longer than PANEL_KEY is never stored, so the panel always redraws
+int8_t panel_changed(Panel *panel, const void *key, size_t len);
+
+// Stops the build when a key outgrows the panel
+#define PANEL_KEY_FITS(key) _Static_assert(sizeof(key) <= PANEL_KEY, "panel key too long")
+
+// Sends every panel drawn since the last flush to the terminal
+void draw_flush();
+
+// Shows text straight away, outside any panel
+void draw_text(int y, int x, const char *s);
+
+void draw_clear();
+
+// Catches up with a resized terminal. Keys never go through getch, so curses
+// doesn't notice by itself. Layouts made before need making again
+void draw_resize();
+
+void draw_gui(int8_t x, int8_t y);
+
+void draw_piece(Panel *panel, int8_t x, int8_t y, int8_t type, int8_t rot, int8_t ghost);
+
+void draw_board(Panel *panel, Board *board, const Piece *p, int8_t line, int8_t mono);
+
+void draw_queue(Panel *panel, int8_t queue[], int8_t queue_pos);
+
+void draw_hold(Panel *panel, int8_t p, int8_t held);
+
+void draw_keys(Panel *panel, uint16_t inputs);
+
+// With hist, the personal best and how the last split compares with it
+void draw_stats(Panel *panel, uint64_t time, int pieces, int keys, int holds, HistoryStats *hist);
+
+// Running fault count, and the fastest keys when the last piece was a fault
+void draw_finesse(Panel *panel, int faults, int8_t fault, int8_t keys, Finesse *best);
+
+// Perfect clear plan, each cell numbered by the step that fills it
+void draw_pc(Panel *panel, PcResult *res);
+
+// Latency, draw and frame time percentiles so far, and missed deadlines
+void draw_perf(Panel *panel, Perf *perf);
+
+// Garbage waiting to rise, as a column from the bottom up
+void draw_garbage(Panel *panel, int pending);
+
+// The other player's board with their garbage meter, in a panel of
+// BOARD_HEIGHT + 2 rows by BOARD_WIDTH * 2 + 3 columns
+void draw_peer(Panel *panel, Peer *peer);
+
+#endif
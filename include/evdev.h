@@ -0,0 +1,27 @@
+#ifndef EVDEV_H
+#define EVDEV_H
+
+#include <stdint.h>
+
+#define EVDEV_DIR "/dev/input"
+#define EVDEV_MAX 16
+
+// A key transition as the kernel saw it, code is a linux KEY_ code
+typedef struct EvdevKey {
+    uint64_t time;
+    uint16_t code;
+    int8_t pressed;
+} EvdevKey;
+
+// Opens every readable keyboard under EVDEV_DIR without grabbing it, and
+// returns an epoll descriptor watching all of them, or -1 if there were none
+int evdev_open();
+
+void evdev_close(int epfd);
+
+// Reads up to max pending key transitions without blocking, stamped with
+// the kernel's CLOCK_MONOTONIC time and in time order across keyboards,
+// returns how many were stored
+int evdev_read(int epfd, EvdevKey *out, int max);
+
+#endif
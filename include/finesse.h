@@ -0,0 +1,33 @@
+#ifndef FINESSE_H
+#define FINESSE_H
+
+#include <stdint.h>
+#include "board.h"
+#include "search.h"
+
+// Fewest keys from spawn to a placement, the hard drop included
+typedef struct Finesse {
+    int8_t keys[SEARCH_MAX_PATH + 1];
+    int8_t len;
+} Finesse;
+
+// Cheapest way to each (rot, x) from spawn on an empty board, without soft
+// drop, generated at build time by tools/gen_finesse.c
+// len is -1 where the column can't be reached
+typedef struct FinesseMove {
+    int8_t y;
+    int8_t len;
+    int8_t keys[SEARCH_MAX_PATH];
+} FinesseMove;
+
+extern const FinesseMove finesse_moves[BAG_SZ][4][BOARD_WIDTH];
+
+// The moves above stay valid while every row from this one up is empty
+extern const int8_t finesse_clear_row[BAG_SZ];
+
+// Finds the shortest key sequence that puts the piece where p (already
+// dropped, not yet locked) is. Placements reachable from the top never use
+// soft drop. Returns the length or -1 if the placement is unreachable
+int8_t finesse_check(Board *board, Piece *p, Finesse *out);
+
+#endif
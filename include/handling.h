@@ -0,0 +1,49 @@
+#ifndef HANDLING_H
+#define HANDLING_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Auto-shift and soft drop timing, driven by input timestamps rather than
+// frame counts so movement is the same at any frame rate
+typedef struct Handling {
+    uint64_t das;
+    uint64_t arr;
+    uint32_t sdf;
+    // Soft drop interval per cell, 0 for instant
+    uint64_t sd_interval;
+
+    int8_t held[2];
+    // Direction being auto-shifted: -1 left, 1 right, 0 none
+    int8_t dir;
+    uint64_t charge_start;
+    uint32_t shifted;
+
+    int8_t sd_held;
+    uint64_t sd_start;
+    uint32_t dropped;
+} Handling;
+
+// grav is the natural fall speed in ns per cell, soft drop is sdf times as
+// fast
+void handling_init(Handling *h, Config *config, uint64_t grav);
+
+// Follows a change of gravity, 0 (20G) makes soft drop instant
+void handling_gravity(Handling *h, uint64_t grav);
+
+// Feed a left (-1) or right (1) transition, returns the cells to shift now
+int8_t handling_shift_key(Handling *h, int8_t dir, int8_t pressed, uint64_t time);
+
+void handling_sd_key(Handling *h, int8_t pressed, uint64_t time);
+
+// Cells to auto-shift since the last call, signed by direction
+// BOARD_WIDTH (or its negative) when ARR is 0
+int8_t handling_shift(Handling *h, uint64_t now);
+
+// Cells to soft drop since the last call, ARR_HEIGHT when instant
+int8_t handling_drop(Handling *h, uint64_t now);
+
+// Restarts soft drop timing for a freshly spawned piece
+void handling_new_piece(Handling *h, uint64_t time);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "core.h"
+
+#define HISTORY_MAGIC "TTHS"
+#define HISTORY_INDEX_MAGIC "TTHI"
+#define HISTORY_VERSION 1
+
+// Split times are ranked in buckets this wide, the last takes everything
+// slower
+#define HISTORY_BUCKET_US 50000
+#define HISTORY_BUCKETS 8192
+
+// One finished sprint, as appended to the history file
+typedef struct HistoryRun {
+    // Unix time it finished
+    int64_t date;
+    uint32_t seed;
+    uint32_t time_us;
+    // Time to each SPLIT_LINES lines, the last is the finish
+    uint32_t splits_us[SPLITS];
+    uint16_t pieces;
+    uint16_t keys;
+    uint16_t holds;
+    uint16_t faults;
+} HistoryRun;
+
+// The history file is this header followed by every run in the order they
+// finished. It is only ever appended to
+typedef struct HistoryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;
+    uint32_t pad;
+} HistoryHeader;
+
+// Everything shown during play, kept up to date as runs are added and
+// mapped in whole, so no lookup depends on the number of runs
+// It can always be rebuilt from the history file
+typedef struct HistoryIndex {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;
+    // Set while a run is being added, a crash midway leaves it set and the
+    // index is rebuilt
+    uint32_t dirty;
+    // Runs of the history file counted so far
+    uint64_t runs;
+    // The personal best and its place in the file
+    uint64_t best_n;
+    HistoryRun best;
+    // Fastest time to each split over every run
+    uint32_t gold_us[SPLITS];
+    // Runs that reached each split within each bucket or a faster one
+    uint32_t upto[SPLITS][HISTORY_BUCKETS];
+} HistoryIndex;
+
+typedef struct History {
+    int fd;
+    HistoryIndex *index;
+} History;
+
+// What stat_win shows of the history for the game in progress
+typedef struct HistoryStats {
+    uint32_t runs;
+    // 0 without any runs
+    uint32_t best_us;
+    // The last split reached against the best run's, valid once split >= 0
+    int32_t delta_us;
+    // Percent of runs slower to that split
+    uint16_t beats;
+    int8_t split;
+} HistoryStats;
+
+// Directory the history is kept in, created if missing
+int history_dir(char *path, size_t len);
+
+// Opens the history in dir, creating it if missing, and brings the index up
+// to date with any runs it hasn't counted
+int history_open(History *h, const char *dir);
+
+void history_close(History *h);
+
+// Appends a finished game and counts it in the index
+int history_add(History *h, GameState *s, uint32_t seed);
+
+// Compares the splits s has reached so far with the history
+void history_stats(History *h, GameState *s, HistoryStats *out);
+
+#endif
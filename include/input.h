@@ -1,14 +1,97 @@
 #ifndef INPUT_H
 #define INPUT_H
 
-#define KEYS 10
+#define MAX_EVENTS 64
 #include <termios.h>
 #include "config.h"
 
+// A key transition, stamped with the time the bytes carrying it were read
+typedef struct InputEvent {
+    uint64_t time;
+    int8_t key;
+    int8_t pressed;
+} InputEvent;
+
+typedef struct InputEvents {
+    InputEvent ev[MAX_EVENTS];
+    int n;
+} InputEvents;
+
+// Bound keys held down, bit n = keymap slot n, and the actions they add up
+// to, bit n = action n
+typedef struct InputState {
+    uint64_t down;
+    uint16_t actions;
+} InputState;
+
+enum KeyType {
+    KEY_PRESS = 1,
+    KEY_REPEAT,
+    KEY_RELEASE,
+    // Not a key, the terminal's reply to CSI ? u with the flags in key
+    KEY_FLAGS
+};
+
+// One decoded kitty keyboard protocol event, with the key as a unicode
+// code point, a kitty functional key number or a curses KEY_ code
+typedef struct KeyEvent {
+    uint32_t key;
+    // Bit field as sent, shift 1, alt 2, ctrl 4, super 8 and so on
+    uint8_t mods;
+    enum KeyType type;
+} KeyEvent;
+
+// Streaming CSI u parser, sequences may be split across reads
+typedef struct KeyDecoder {
+    uint8_t state;
+    uint8_t field;
+    uint8_t sub;
+    // Inside CSI ?, a reply rather than a key
+    uint8_t query;
+    uint32_t params[3][2];
+} KeyDecoder;
+
+// Decodes n bytes and stores up to max complete events in out, returns how
+// many were stored
+int key_decode(KeyDecoder *d, const char *buf, size_t n, KeyEvent *out, int max);
+
+// How the input mode was settled on, for --startup-trace
+typedef struct InputProbe {
+    // When mode_set was entered and returned
+    uint64_t start;
+    uint64_t end;
+    // What mode_set picked, whether it came from the cache and whether
+    // checking it is still going
+    enum InputMode mode;
+    int8_t cached;
+    int8_t pending;
+    // The kitty query was answered, with these flags
+    int8_t answered;
+    uint32_t flags;
+    // When the check finished and whether the cached mode was wrong
+    uint64_t verified;
+    int8_t changed;
+    KeyDecoder decoder;
+} InputProbe;
+
+// Picks the input mode, falling back from evdev or extkeys as far as it has
+// to. A terminal seen before on the same tty gets its mode from the cache
+// straight away, and input_verify finishes checking it
 enum InputMode mode_set(enum InputMode mode, struct termios *old, struct termios *new, int *fd);
 
+// Call once a frame after get_inputs. Returns 1 if the cached mode turned out
+// wrong and config->mode and *fd now hold the right one, its bindings still
+// need compiling
+int input_verify(Config *config, int *fd);
+
+const InputProbe *input_probe();
+
 void input_clean(enum InputMode mode, struct termios *old, int fd);
 
-void get_inputs(Config *config, int fd, int8_t inputs[KEYS]);
+// Updates inputs with everything pending and appends the transitions to events
+void get_inputs(Config *config, int fd, InputState *inputs, InputEvents *events);
+
+// The descriptor input arrives on for the current mode, for poll
+int input_fd(Config *config, int fd);
 
 #endif
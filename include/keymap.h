@@ -0,0 +1,39 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdint.h>
+
+// Distinct keys a map can hold, each gets one bit of a held mask
+#define KEYMAP_SLOTS 64
+// Codes below this are looked up directly: scancodes, evdev codes, ASCII
+// and curses KEY_ codes
+#define KEYMAP_DIRECT 1024
+// Open addressed table for everything above, kitty's unicode and functional
+// key codes, kept at most half full
+#define KEYMAP_HASH (KEYMAP_SLOTS * 2)
+
+// Compiled key bindings, any number of keys to an action and any number of
+// actions to a key
+typedef struct Keymap {
+    // Slot + 1, 0 for unbound
+    uint8_t direct[KEYMAP_DIRECT];
+    // 0 marks an empty entry, no input mode uses it as a key
+    uint32_t hash_keys[KEYMAP_HASH];
+    uint8_t hash_slots[KEYMAP_HASH];
+    // Actions each slot's key triggers, bit n = action n
+    uint16_t actions[KEYMAP_SLOTS];
+    uint8_t slots;
+} Keymap;
+
+void keymap_clear(Keymap *map);
+
+// Binds key to action, returns -1 if the map is full or key is 0
+int keymap_bind(Keymap *map, uint32_t key, uint8_t action);
+
+// Slot + 1 of key, 0 if it isn't bound
+int keymap_slot(const Keymap *map, uint32_t key);
+
+// Actions held down by the keys in down, bit n = slot n
+uint16_t keymap_actions(const Keymap *map, uint64_t down);
+
+#endif
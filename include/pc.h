@@ -0,0 +1,92 @@
+#ifndef PC_H
+#define PC_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "core.h"
+
+// Pieces visible to the solver past the current one, the drawn queue
+#define PC_PREVIEW 5
+// Current, preview and hold
+#define PC_MAX_PIECES (PC_PREVIEW + 2)
+#define PC_MAX_HEIGHT 4
+// Visited boards remembered per solve, a power of two
+#define PC_TABLE_SZ (1 << 16)
+// A solve gives up after this many boards
+#define PC_MAX_NODES 2000000
+
+enum PcStatus {
+    PC_IDLE,
+    PC_SOLVING,
+    PC_FOUND,
+    PC_NONE,
+    // Stopped at PC_MAX_NODES, there may still be one
+    PC_GAVE_UP
+};
+
+// What the solver needs from a game, copied so it can run on its own thread
+typedef struct PcInput {
+    uint16_t rows[PC_MAX_HEIGHT];
+    // Rows above PC_MAX_HEIGHT are in use, so no clear is in reach
+    int8_t too_high;
+    int8_t curr;
+    int8_t hold;
+    int8_t hold_used;
+    int8_t preview[PC_PREVIEW];
+} PcInput;
+
+typedef struct PcResult {
+    enum PcStatus status;
+    uint32_t id;
+    int8_t height;
+    int8_t n;
+    // Per step, the piece placed and whether hold was pressed first
+    int8_t type[PC_MAX_PIECES];
+    int8_t held[PC_MAX_PIECES];
+    // Board at the time of the request, 0 for empty, -1 for the existing
+    // stack, otherwise the step (from 1) that fills the cell
+    int8_t grid[PC_MAX_HEIGHT][BOARD_WIDTH];
+    uint64_t nodes;
+} PcResult;
+
+typedef struct PcEntry {
+    uint64_t key;
+    uint32_t gen;
+} PcEntry;
+
+// Solves on a background thread, a new request abandons the one in progress
+typedef struct PcSolver {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int8_t started;
+    int8_t quit;
+
+    PcInput input;
+    int8_t pending;
+    uint32_t request;
+    PcResult result;
+    int8_t ready;
+
+    // Owned by the solving thread
+    PcEntry *table;
+    uint32_t gen;
+} PcSolver;
+
+void pc_input(PcInput *in, GameState *s);
+
+// Finds placements for the visible pieces that leave the board empty on the
+// calling thread, giving up once a request newer than out->id comes in
+void pc_solve(PcSolver *pc, PcInput *in, PcResult *out);
+
+int pc_init(PcSolver *pc);
+
+void pc_free(PcSolver *pc);
+
+// Queues a solve of the game as it is now and returns its id
+uint32_t pc_request(PcSolver *pc, GameState *s);
+
+// Copies out a finished result, returns 1 if there was a new one
+int pc_poll(PcSolver *pc, PcResult *out);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include "input.h"
+
+// Log-linear buckets: exact below 16ns, then 16 per power of two, so every
+// bucket is within about 6% of the values in it, up to 2^40ns
+#define HIST_SUB 16
+#define HIST_OCTAVES 40
+#define HIST_BUCKETS ((HIST_OCTAVES - 3) * HIST_SUB)
+
+typedef struct Hist {
+    uint32_t counts[HIST_BUCKETS];
+    uint64_t n;
+    uint64_t sum;
+    uint64_t max;
+} Hist;
+
+// Frame timing for one run of the program, in ns
+typedef struct Perf {
+    // From the read that picked up a key to the refresh that showed it
+    Hist latency;
+    // From the state update to the refresh, curses' share of the above
+    Hist draw;
+    // From the input read at the top of a frame to its refresh
+    Hist frame;
+    // Versus, from the key that sent garbage to the refresh that showed it
+    // on the other player's screen
+    Hist garbage;
+    uint64_t frames;
+    // Frame deadlines that had passed by the time the loop got to them
+    uint64_t missed;
+    // Draw the overlay
+    int8_t overlay;
+} Perf;
+
+void hist_add(Hist *h, uint64_t ns);
+
+// Upper edge of the bucket holding the p-th fraction of values
+uint64_t hist_percentile(Hist *h, double p);
+
+void perf_init(Perf *perf);
+
+// Records a frame that read events at read, updated the game at update and
+// was on screen at render
+void perf_frame(Perf *perf, InputEvents *events, uint64_t read, uint64_t update, uint64_t render);
+
+// Writes a summary and the non-empty buckets of each histogram
+int perf_write(Perf *perf, const char *path);
+
+// $XDG_STATE_HOME/tetty/perf.txt, its directory created if missing
+int perf_path(char *path, size_t len);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef PIECES_H
+#define PIECES_H
+
+#include <stdint.h>
+
+#define BAG_SZ 7
+
+extern const int8_t pieces[BAG_SZ][4][4][2];
+
+extern const int8_t offsets[3][4][5][2];
+
+extern const int8_t offsets2[2][4][2][2];
+
+#endif
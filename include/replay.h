@@ -0,0 +1,84 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "core.h"
+
+#define REPLAY_MAGIC "TTRP"
+#define REPLAY_VERSION 4
+
+// A recorded game: the seed, handling and game rules it was played with, the
+// result, and every transition of the game keys as (delta µs varint, held key
+// bitmask)
+// Records are appended to memory during play and written once it is over
+// Version 3 replays have no rules and play back as they always did, without
+// lock delay on the sprint's gravity
+typedef struct Replay {
+    uint32_t seed;
+    uint16_t das;
+    uint16_t arr;
+    uint16_t sdf;
+    uint16_t lock;
+    uint8_t lock_resets;
+    uint8_t level;
+    uint8_t levels;
+    uint32_t gravity[LEVELS];
+
+    uint8_t finished;
+    uint32_t time_us;
+    uint16_t pieces;
+    uint16_t keys;
+    uint16_t holds;
+    uint8_t cleared;
+
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+
+    // Recording: time and mask of the last record
+    // Playback: read offset and the time of the record at it
+    uint64_t last_time;
+    uint8_t mask;
+    size_t pos;
+} Replay;
+
+void replay_init(Replay *r, Config *config, uint32_t seed);
+
+// Starts a new recording in the buffer of an old one
+void replay_restart(Replay *r, Config *config, uint32_t seed);
+
+void replay_free(Replay *r);
+
+// Appends the held game keys after a transition at time (ns since start)
+void replay_record(Replay *r, uint64_t time, uint8_t mask);
+
+// Copies the result out of a finished or abandoned game
+void replay_finish(Replay *r, GameState *s);
+
+int replay_save(Replay *r, const char *path);
+
+int replay_load(Replay *r, const char *path);
+
+// Handling and rules the replay was recorded with
+void replay_config(Replay *r, Config *config);
+
+// Playback cursor, replay_peek returns 0 once every record has been read
+void replay_rewind(Replay *r);
+
+int replay_peek(Replay *r, uint64_t *time);
+
+int replay_next(Replay *r, uint64_t *time, uint8_t *mask);
+
+// Feeds the transition to the core as the live game did
+void replay_apply(GameState *s, uint8_t old_mask, uint8_t mask, uint64_t time);
+
+// Plays the whole replay through the core as fast as it can and returns 1 if
+// the outcome matches the recorded result
+int replay_run(Replay *r, GameState *s);
+
+// Directory replays are saved in, created if missing
+int replay_dir(char *path, size_t len);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+#include "config.h"
+#include "board.h"
+
+// Pseudo keys for a shift held until the piece hits a wall
+#define DAS_LEFT KEYS
+#define DAS_RIGHT (KEYS + 1)
+
+#define SEARCH_MAX_PATH 16
+
+typedef struct SearchNode {
+    // Keys from the start, -1 if not reached
+    int8_t cost;
+    // Key that led here and the index of the state it was pressed in
+    int8_t key;
+    int16_t parent;
+} SearchNode;
+
+// Breadth first search over (x, y, rot) of one piece, moved with the same
+// move_piece and spin_piece calls the game makes, so every kick is real
+// Each tap, held shift, spin or soft drop to the floor costs one key
+typedef struct Search {
+    SearchNode nodes[4 * ARR_HEIGHT * BOARD_WIDTH];
+    // Reached states in the order they were found, cheapest first
+    int16_t order[4 * ARR_HEIGHT * BOARD_WIDTH];
+    int n;
+    int8_t type;
+} Search;
+
+// State index for a piece position
+#define SEARCH_INDEX(x, y, rot) (((rot) * ARR_HEIGHT + (y)) * BOARD_WIDTH + (x))
+
+void search_run(Search *s, Board *board, Piece *start, int8_t soft_drop);
+
+// Moves the piece as one key of a path would
+void search_press(Board *board, Piece *p, int8_t key);
+
+// Piece in the state at index
+void search_piece(Search *s, int16_t index, Piece *p);
+
+// Writes the keys leading to index and returns how many there are
+int8_t search_path(Search *s, int16_t index, int8_t keys[SEARCH_MAX_PATH]);
+
+// Identifies the cells a piece covers, so rotations that fill the same cells
+// compare equal
+uint64_t search_cells(Piece *p);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include <stdint.h>
+#include "core.h"
+
+#define SPECTATE_MAGIC 0x53595454
+#define SPECTATE_VERSION 1
+#define SPECTATE_QUEUE 5
+
+// Everything a viewer needs to draw one frame, a few hundred bytes
+typedef struct SpectateFrame {
+    uint64_t time;
+    // Bumped with every publish, so no two frames share one
+    uint32_t frame;
+    // Bumped with every new game, and board_version with every change to
+    // the stack, so viewers know what to redraw
+    uint32_t game;
+    uint32_t board_version;
+    uint16_t rows[BOARD_HEIGHT];
+    int8_t colors[BOARD_HEIGHT][BOARD_WIDTH];
+    int8_t x;
+    int8_t y;
+    int8_t type;
+    int8_t rot;
+    int8_t hold;
+    int8_t hold_used;
+    int8_t queue[SPECTATE_QUEUE];
+    int8_t done;
+    uint16_t inputs;
+    int32_t pieces;
+    int32_t keys;
+    int32_t holds;
+    int32_t cleared;
+    int32_t faults;
+} SpectateFrame;
+
+// The shared segment, one writer and any number of readers
+// seq is odd while a frame is being written. Readers take seq, read the
+// frame, in place or by copy, and only trust it if seq was even and hasn't
+// moved since
+typedef struct SpectateShm {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    // Cleared when the game exits
+    uint32_t live;
+    uint32_t seq;
+    SpectateFrame frame;
+} SpectateShm;
+
+typedef struct Spectate {
+    SpectateShm *shm;
+    char name[64];
+    uint32_t game;
+    uint32_t published;
+} Spectate;
+
+// Creates the segment, name as for shm_open. One left behind by a game that
+// has closed it is replaced, otherwise the name is in use and this fails
+// with EEXIST
+int spectate_open(Spectate *sp, const char *name);
+
+void spectate_close(Spectate *sp);
+
+// Marks the start of a new game for viewers
+void spectate_new_game(Spectate *sp);
+
+// Copies the visible state of s into the segment
+void spectate_publish(Spectate *sp, GameState *s);
+
+// Maps a segment read only, NULL if there is none or it's another version
+SpectateShm *spectate_attach(const char *name);
+
+void spectate_detach(SpectateShm *shm);
+
+// Takes a consistent copy of the latest frame, returns 0 if the writer kept
+// it busy for every try
+int spectate_read(SpectateShm *shm, SpectateFrame *out);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef TERMCACHE_H
+#define TERMCACHE_H
+
+#include <stddef.h>
+#include "config.h"
+
+// Terminals remembered, the least recently detected are forgotten
+#define TERMCACHE_MAX 32
+
+// The input mode detected last time for this TERM on this tty, and the
+// console scancodes were read from if there was one
+// Returns -1 if the terminal hasn't been seen
+int termcache_get(enum InputMode *mode, char *console, size_t len);
+
+// Remembers mode for this TERM and tty, console may be NULL
+int termcache_put(enum InputMode mode, const char *console);
+
+#endif
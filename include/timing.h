@@ -0,0 +1,40 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_MS 1000000ULL
+
+// Frames more than this far behind are dropped instead of simulated
+#define MAX_CATCHUP 8
+
+// Fixed timestep pacing against absolute CLOCK_MONOTONIC deadlines
+// Sleeping to an absolute deadline keeps the rate exact no matter how long
+// each frame took, and overruns are caught up instead of wrapping the sleep
+typedef struct Scheduler {
+    uint64_t period;
+    uint64_t deadline;
+    uint64_t frames;
+    // Frames whose deadline had already passed when the loop got to them
+    uint64_t late;
+    // Frames skipped because the loop fell more than MAX_CATCHUP behind
+    uint64_t dropped;
+    uint64_t worst_late;
+} Scheduler;
+
+uint64_t get_ns();
+
+void sched_init(Scheduler *s, uint64_t period);
+
+// Blocks until the next deadline or until fd is readable, whichever is first
+// Returns how many simulation ticks are due: 0 when woken early by input, more
+// than one when the previous frame overran. fd may be -1 to only sleep
+int sched_wait(Scheduler *s, int fd);
+
+// The same, woken by any of up to SCHED_FDS descriptors, -1 entries are
+// skipped
+#define SCHED_FDS 4
+int sched_wait_any(Scheduler *s, const int *fds, int n);
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <stdint.h>
+#include "board.h"
+
+#define VERSUS_VERSION 1
+
+// Messages waiting to go out, and garbage waiting to go to the core
+#define VERSUS_QUEUE 64
+
+// Board cells packed two to a byte, bottom row first
+#define SNAPSHOT_BYTES (BOARD_HEIGHT * BOARD_WIDTH / 2)
+
+// Each message is one SOCK_SEQPACKET packet, a type byte and the packed
+// payload below, in host byte order since both ends share the machine
+enum MsgType {
+    MSG_HELLO = 1,
+    MSG_PIECE,
+    MSG_GARBAGE,
+    MSG_BOARD,
+    MSG_LOST
+};
+
+typedef struct __attribute__((packed)) MsgHello {
+    uint8_t version;
+} MsgHello;
+
+// Sent whenever pieces are placed, totals for the game so far
+typedef struct __attribute__((packed)) MsgPiece {
+    uint16_t pieces;
+    uint16_t cleared;
+    uint16_t sent;
+} MsgPiece;
+
+// time is the CLOCK_MONOTONIC time of the key that sent it
+typedef struct __attribute__((packed)) MsgGarbage {
+    uint8_t lines;
+    uint8_t hole;
+    uint64_t time;
+} MsgGarbage;
+
+// The visible stack with the falling piece, and garbage waiting under it
+typedef struct __attribute__((packed)) MsgBoard {
+    uint8_t pending;
+    uint8_t cells[SNAPSHOT_BYTES];
+} MsgBoard;
+
+#define MSG_MAX (1 + sizeof(MsgBoard))
+
+// The other player, as far as their messages have said
+typedef struct Peer {
+    int8_t connected;
+    int8_t lost;
+    int8_t colors[BOARD_HEIGHT][BOARD_WIDTH];
+    // Bumped with every snapshot, for redraws
+    uint32_t version;
+    int pending;
+    int pieces;
+    int cleared;
+    int sent;
+} Peer;
+
+typedef struct IncomingGarbage {
+    int8_t lines;
+    int8_t hole;
+    uint64_t time;
+} IncomingGarbage;
+
+// One end of a match, the first instance on a path listens and the second
+// connects to it
+// Nothing here ever blocks: sends that would are queued and retried on the
+// next poll, and reads only take what is already there
+typedef struct Versus {
+    int listen_fd;
+    int fd;
+    char path[108];
+    Peer peer;
+    // Garbage received since the game last took it
+    IncomingGarbage in[VERSUS_QUEUE];
+    int n_in;
+    uint8_t out[VERSUS_QUEUE][MSG_MAX];
+    uint8_t out_len[VERSUS_QUEUE];
+    int n_out;
+    // Last snapshot sent, so unchanged boards aren't
+    MsgBoard board;
+    // Picks the gap in garbage we send
+    uint64_t rng;
+} Versus;
+
+// Connects to path, or listens on it if nobody is there yet
+int versus_open(Versus *v, const char *path);
+
+void versus_close(Versus *v);
+
+// Accepts a waiting peer, sends what was queued and reads every message
+// already received
+void versus_poll(Versus *v);
+
+void versus_garbage(Versus *v, int8_t lines, uint64_t time);
+
+void versus_piece(Versus *v, int pieces, int cleared, int sent);
+
+// Sends the board with p drawn into it, if it changed since the last one
+void versus_board(Versus *v, Board *board, Piece *p, int pending);
+
+void versus_lost(Versus *v);
+
+// Forgets the peer's last game, for when either side starts a new one
+void versus_reset(Versus *v);
+
+#endif
@@ -0,0 +1,198 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ansi.h"
+
+// Worst case per cell: a full cursor move, a full SGR and a 4 byte glyph
+#define CELL_OUT 48
+
+static const AnsiCell blank = { " ", 1, 0, 0 };
+
+int ansi_init(AnsiScreen *scr, int fd, int rows, int cols) {
+    memset(scr, 0, sizeof(*scr));
+    scr->fd = fd;
+    scr->rows = rows;
+    scr->cols = cols;
+    scr->front = malloc(rows * cols * sizeof(AnsiCell));
+    scr->back = malloc(rows * cols * sizeof(AnsiCell));
+    scr->cap = (size_t) rows * cols * CELL_OUT + 16;
+    scr->out = malloc(scr->cap);
+    if (!scr->front || !scr->back || !scr->out) {
+        ansi_free(scr);
+        return -1;
+    }
+    for (int i = 0; i < ANSI_PAIRS; i++)
+        scr->pairs[i] = "";
+    for (int i = 0; i < rows * cols; i++)
+        scr->front[i] = scr->back[i] = blank;
+    return 0;
+}
+
+void ansi_free(AnsiScreen *scr) {
+    free(scr->front);
+    free(scr->back);
+    free(scr->out);
+    scr->front = scr->back = NULL;
+    scr->out = NULL;
+}
+
+int ansi_resize(AnsiScreen *scr, int rows, int cols) {
+    AnsiCell *front = malloc(rows * cols * sizeof(AnsiCell));
+    AnsiCell *back = malloc(rows * cols * sizeof(AnsiCell));
+    size_t cap = (size_t) rows * cols * CELL_OUT + 16;
+    char *out = malloc(cap);
+    if (!front || !back || !out) {
+        free(front);
+        free(back);
+        free(out);
+        return -1;
+    }
+    ansi_free(scr);
+    scr->front = front;
+    scr->back = back;
+    scr->out = out;
+    scr->cap = cap;
+    scr->rows = rows;
+    scr->cols = cols;
+    ansi_clear(scr);
+    return 0;
+}
+
+void ansi_pair(AnsiScreen *scr, uint8_t pair, const char *sgr) {
+    if (pair < ANSI_PAIRS)
+        scr->pairs[pair] = sgr;
+}
+
+void ansi_fill(AnsiScreen *scr, int y, int x, int h, int w) {
+    for (int i = y < 0 ? 0 : y; i < y + h && i < scr->rows; i++)
+        for (int j = x < 0 ? 0 : x; j < x + w && j < scr->cols; j++)
+            scr->back[i * scr->cols + j] = blank;
+}
+
+static int utf8_len(unsigned char c) {
+    if (c < 0x80)
+        return 1;
+    if ((c >> 5) == 6)
+        return 2;
+    if ((c >> 4) == 14)
+        return 3;
+    return 4;
+}
+
+int ansi_puts(AnsiScreen *scr, int y, int x, int end, uint8_t pair, uint8_t attr, const char *s) {
+    if (end > scr->cols)
+        end = scr->cols;
+    while (*s && x < end) {
+        int n = utf8_len(*s);
+        if (y >= 0 && y < scr->rows && x >= 0) {
+            AnsiCell *c = &scr->back[y * scr->cols + x];
+            memset(c->glyph, 0, sizeof(c->glyph));
+            for (int i = 0; i < n; i++) {
+                if (!s[i]) {
+                    n = i;
+                    break;
+                }
+                c->glyph[i] = s[i];
+            }
+            c->len = n;
+            c->pair = pair;
+            c->attr = attr;
+        }
+        s += n;
+        x++;
+    }
+    return x;
+}
+
+void ansi_clear(AnsiScreen *scr) {
+    for (int i = 0; i < scr->rows * scr->cols; i++)
+        scr->front[i] = scr->back[i] = blank;
+    static const char seq[] = "\e[0m\e[H\e[2J";
+    if (write(scr->fd, seq, sizeof(seq) - 1) > 0) {
+        scr->bytes += sizeof(seq) - 1;
+        scr->writes++;
+    }
+}
+
+static size_t sgr(AnsiScreen *scr, char *out, uint8_t pair, uint8_t attr) {
+    const char *p = pair < ANSI_PAIRS ? scr->pairs[pair] : "";
+    return sprintf(out, "\e[0%s%s%sm", *p ? ";" : "", p, attr & ANSI_REVERSE ? ";7" : "");
+}
+
+long ansi_flush(AnsiScreen *scr) {
+    char *out = scr->out;
+    size_t len = 0;
+    // Where the cursor is and the attributes in effect, unknown to start
+    // with in case anything else wrote to the terminal
+    int cy = -1;
+    int cx = -1;
+    int pair = -1;
+    int attr = -1;
+
+    for (int y = 0; y < scr->rows; y++) {
+        AnsiCell *front = &scr->front[y * scr->cols];
+        AnsiCell *back = &scr->back[y * scr->cols];
+        for (int x = 0; x < scr->cols; x++) {
+            if (!memcmp(&front[x], &back[x], sizeof(AnsiCell)))
+                continue;
+
+            if (cy == y && x > cx) {
+                // Rewriting a short gap is cheaper than skipping it, if it
+                // doesn't need an attribute change
+                size_t gap = 0;
+                int same = 1;
+                for (int i = cx; i < x && same; i++) {
+                    gap += back[i].len;
+                    same = back[i].pair == pair && back[i].attr == attr;
+                }
+                size_t skip = x - cx == 1 ? 3 : x - cx < 10 ? 4 : 5;
+                if (same && gap <= skip) {
+                    for (int i = cx; i < x; i++) {
+                        memcpy(out + len, back[i].glyph, back[i].len);
+                        len += back[i].len;
+                    }
+                } else if (x - cx == 1) {
+                    len += sprintf(out + len, "\e[C");
+                } else {
+                    len += sprintf(out + len, "\e[%dC", x - cx);
+                }
+            } else if (cy != y || cx != x) {
+                if (x)
+                    len += sprintf(out + len, "\e[%d;%dH", y + 1, x + 1);
+                else if (y)
+                    len += sprintf(out + len, "\e[%dH", y + 1);
+                else
+                    len += sprintf(out + len, "\e[H");
+            }
+
+            if (back[x].pair != pair || back[x].attr != attr) {
+                pair = back[x].pair;
+                attr = back[x].attr;
+                len += sgr(scr, out + len, pair, attr);
+            }
+            memcpy(out + len, back[x].glyph, back[x].len);
+            len += back[x].len;
+            front[x] = back[x];
+            cy = y;
+            cx = x + 1;
+        }
+    }
+    if (!len)
+        return 0;
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(scr->fd, out + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return -1;
+        }
+        done += n;
+        scr->writes++;
+    }
+    scr->bytes += len;
+    return len;
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+#include "board.h"
+
+int8_t check_collide(Board *board, int8_t x, int8_t y, int8_t type, int8_t rot) {
+    if ((uint8_t) x >= BOARD_WIDTH)
+        return 1;
+
+    const CollideMask *m = &collide_masks[type][rot][x];
+    if (y < m->min_y || y > m->max_y)
+        return 1;
+
+    uint64_t rows;
+    uint64_t mask;
+    memcpy(&rows, &board->rows[y - m->bottom], sizeof(rows));
+    memcpy(&mask, m->rows, sizeof(mask));
+    return (rows & mask) != 0;
+}
+
+void move_piece(Board *board, Piece *p, int8_t h, int8_t amount) {
+    int8_t collision = 0;
+    int8_t last_x = p->x;
+    int8_t last_y = p->y;
+    int8_t step = (amount < 0) ? -1 : 1;
+
+    for (int8_t i = step; i != amount + step; i += step) {
+        int8_t x = p->x + (h ? i : 0);
+        int8_t y = p->y + (h ? 0 : i);
+
+        collision = check_collide(board, x, y, p->type, p->rot);
+
+        if (!collision) {
+            last_x = x;
+            last_y = y;
+        } else
+            break;
+    }
+
+    p->x = last_x;
+    p->y = last_y;
+
+    for (int8_t i = 0; i < 4; i++) {
+        p->coords[i][0] = p->x + pieces[p->type][p->rot][i][0];
+        p->coords[i][1] = p->y - pieces[p->type][p->rot][i][1];
+    }
+}
+
+void board_columns(Board *board, uint64_t cols[BOARD_WIDTH]) {
+    memset(cols, 0, BOARD_WIDTH * sizeof(*cols));
+    for (int8_t y = 0; y < ARR_HEIGHT; y++)
+        for (uint16_t row = board->rows[y]; row; row &= row - 1)
+            cols[__builtin_ctz(row)] |= 1ULL << y;
+}
+
+int8_t drop_distance(Board *board, const uint64_t cols[BOARD_WIDTH], Piece *p) {
+    int8_t drop = ARR_HEIGHT;
+    for (int8_t i = 0; i < 4; i++) {
+        int8_t x = p->coords[i][0];
+        int8_t y = p->coords[i][1];
+        // A piece spawned into the stack falls as move_piece would take it
+        if (cols[x] >> y & 1) {
+            int8_t to = p->y;
+            while (!check_collide(board, p->x, to - 1, p->type, p->rot))
+                to--;
+            return p->y - to;
+        }
+        uint64_t below = cols[x] & ((1ULL << y) - 1);
+        int8_t d = below ? y - 64 + __builtin_clzll(below) : y;
+        if (d < drop)
+            drop = d;
+    }
+    return drop;
+}
+
+void spin_piece(Board *board, Piece *p, int8_t spin) {
+    // 0 = cw
+    // 1 = 180
+    // 2 = ccw
+    int8_t init_rot = p->rot;
+    int8_t class = 0;
+    if (p->type == 0) class = 1;
+    if (p->type == 3) class = 2;
+    p->rot = (p->rot + spin + 1) % 4;
+
+    int8_t collision = 0;
+    for (int8_t i = 0; i < 5; i++) {
+        int8_t x = p->x + (offsets[class][init_rot][i][0] - offsets[class][p->rot][i][0]);
+        int8_t y = p->y + (offsets[class][init_rot][i][1] - offsets[class][p->rot][i][1]);
+
+        // 180 spins only have two tests
+        if (class != 2 && spin == 1) {
+            if (i > 1)
+                break;
+            x = p->x + (offsets2[class][init_rot][i][0] - offsets2[class][p->rot][i][0]);
+            y = p->y + (offsets2[class][init_rot][i][1] - offsets2[class][p->rot][i][1]);
+        }
+
+        collision = check_collide(board, x, y, p->type, p->rot);
+
+        if (!collision) {
+            p->x = x;
+            p->y = y;
+            break;
+        }
+    }
+
+    if (collision) {
+        p->rot = init_rot;
+        return;
+    }
+
+    for (int8_t i = 0; i < 4; i++) {
+        p->coords[i][0] = p->x + pieces[p->type][p->rot][i][0];
+        p->coords[i][1] = p->y - pieces[p->type][p->rot][i][1];
+    }
+
+}
+
+void lock_piece(Board *board, Piece *p) {
+    for (int8_t i = 0; i < 4; i++) {
+        board->rows[p->coords[i][1]] |= 1 << p->coords[i][0];
+        board->colors[p->coords[i][1]][p->coords[i][0]] = p->type + 1;
+    }
+    board->version++;
+}
+
+void gen_piece(Piece *p, int8_t type) {
+    p->type = type;
+    p->rot = SPAWN_ROT;
+    p->x = SPAWN_X;
+    p->y = SPAWN_Y;
+    for (int8_t i = 0; i < 4; i++) {
+        p->coords[i][0] = p->x + pieces[type][0][i][0];
+        p->coords[i][1] = p->y - pieces[type][0][i][1];
+    }
+}
+
+int8_t clear_lines(Board *board) {
+    int8_t cleared = 0;
+    for (int8_t i = 0; i < ARR_HEIGHT; i++) {
+        if (board->rows[i] == FULL_ROW) {
+            cleared++;
+            continue;
+        }
+        if (cleared) {
+            board->rows[i - cleared] = board->rows[i];
+            memcpy(board->colors[i - cleared], board->colors[i], BOARD_WIDTH);
+        }
+    }
+    for (int8_t i = ARR_HEIGHT - cleared; i < ARR_HEIGHT; i++) {
+        board->rows[i] = 0;
+        memset(board->colors[i], 0, BOARD_WIDTH);
+    }
+    if (cleared)
+        board->version++;
+    return cleared;
+}
+
+void add_garbage(Board *board, int8_t lines, int8_t hole) {
+    if (lines <= 0)
+        return;
+    if (lines > ARR_HEIGHT)
+        lines = ARR_HEIGHT;
+    for (int8_t i = ARR_HEIGHT - 1; i >= lines; i--) {
+        board->rows[i] = board->rows[i - lines];
+        memcpy(board->colors[i], board->colors[i - lines], BOARD_WIDTH);
+    }
+    for (int8_t i = 0; i < lines; i++) {
+        board->rows[i] = FULL_ROW & ~(1 << hole);
+        memset(board->colors[i], GARBAGE_COLOR, BOARD_WIDTH);
+        board->colors[i][hole] = 0;
+    }
+    board->version++;
+}
@@ -0,0 +1,381 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bot.h"
+
+void bot_defaults(Config *config) {
+    config->bot_threads = 0;
+    config->bot_depth = 3;
+    config->bot_beam = 32;
+    config->bot_pps = 0;
+    config->bot_holes = 400;
+    config->bot_bump = 20;
+    config->bot_height = 40;
+    config->bot_wells = 20;
+    config->bot_clears[0] = 0;
+    config->bot_clears[1] = 100;
+    config->bot_clears[2] = 250;
+    config->bot_clears[3] = 450;
+    config->bot_clears[4] = 800;
+}
+
+// Penalty for the shape of a settled stack
+static int32_t evaluate(Bot *bot, const uint16_t *rows) {
+    int8_t height[BOARD_WIDTH] = { 0 };
+    uint16_t covered = 0;
+    int32_t holes = 0;
+
+    int8_t top = ARR_HEIGHT - 1;
+    while (top >= 0 && !rows[top])
+        top--;
+    for (int8_t y = top; y >= 0; y--) {
+        uint16_t fresh = rows[y] & ~covered;
+        while (fresh) {
+            height[__builtin_ctz(fresh)] = y + 1;
+            fresh &= fresh - 1;
+        }
+        holes += __builtin_popcount(covered & ~rows[y]);
+        covered |= rows[y];
+    }
+
+    int32_t total = 0;
+    int32_t bump = 0;
+    int32_t wells = 0;
+    for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+        total += height[x];
+        if (x)
+            bump += abs(height[x] - height[x - 1]);
+        int8_t left = x ? height[x - 1] : ARR_HEIGHT;
+        int8_t right = x < BOARD_WIDTH - 1 ? height[x + 1] : ARR_HEIGHT;
+        int8_t depth = (left < right ? left : right) - height[x];
+        if (depth > 0)
+            wells += depth;
+    }
+    return -(holes * bot->holes + bump * bot->bump + total * bot->height + wells * bot->wells);
+}
+
+static uint64_t hash_node(BotNode *n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int8_t y = 0; y < ARR_HEIGHT; y++)
+        h = (h ^ n->rows[y]) * 0x100000001b3ULL;
+    h = (h ^ (uint8_t) n->curr) * 0x100000001b3ULL;
+    h = (h ^ (uint8_t) n->hold) * 0x100000001b3ULL;
+    return (h ^ n->next) * 0x100000001b3ULL;
+}
+
+// Locks p into the rows and clears full ones, returns the lines cleared
+static int8_t place(uint16_t *rows, Piece *p) {
+    for (int8_t i = 0; i < 4; i++)
+        rows[p->coords[i][1]] |= 1 << p->coords[i][0];
+
+    int8_t cleared = 0;
+    for (int8_t y = 0; y < ARR_HEIGHT; y++) {
+        if (rows[y] == FULL_ROW)
+            cleared++;
+        else
+            rows[y - cleared] = rows[y];
+    }
+    for (int8_t y = ARR_HEIGHT - cleared; y < ARR_HEIGHT; y++)
+        rows[y] = 0;
+    return cleared;
+}
+
+// Every distinct landing of the current piece and the one hold would give
+static void expand(Bot *bot, int index, Piece *root_curr) {
+    BotNode *node = &bot->nodes[index];
+    if (node->curr < 0)
+        return;
+
+    Board board;
+    memcpy(board.rows, node->rows, sizeof(board.rows));
+    Search search;
+
+    for (int8_t use_hold = 0; use_hold < 2; use_hold++) {
+        int8_t type = node->curr;
+        int8_t hold = node->hold;
+        int8_t next = node->next;
+        if (use_hold) {
+            if (bot->at_root && bot->hold_used)
+                break;
+            if (node->hold == node->curr)
+                break;
+            if (node->hold < 0) {
+                if (next >= bot->n_pieces)
+                    break;
+                type = bot->pieces[next++];
+            } else {
+                type = node->hold;
+            }
+            hold = node->curr;
+        }
+
+        // The piece in play may already have moved, a new one spawns
+        Piece start;
+        if (bot->at_root && !use_hold)
+            start = *root_curr;
+        else
+            gen_piece(&start, type);
+        if (check_collide(&board, start.x, start.y, start.type, start.rot))
+            continue;
+        search_run(&search, &board, &start, 1);
+
+        uint64_t seen[2 * BOT_MAX_LANDINGS] = { 0 };
+        int landings = 0;
+        for (int i = 0; i < search.n && landings < BOT_MAX_LANDINGS; i++) {
+            Piece p;
+            search_piece(&search, search.order[i], &p);
+            move_piece(&board, &p, 0, -p.y);
+
+            // Cells never include bit 63, so 0 marks a free slot
+            uint64_t cells = search_cells(&p) | 1ULL << 63;
+            uint32_t slot = (cells * 0x9e3779b97f4a7c15ULL) >> 55;
+            while (seen[slot] && seen[slot] != cells)
+                slot = (slot + 1) % (2 * BOT_MAX_LANDINGS);
+            if (seen[slot])
+                continue;
+            seen[slot] = cells;
+            landings++;
+
+            BotNode child;
+            memcpy(child.rows, node->rows, sizeof(child.rows));
+            int8_t cleared = place(child.rows, &p);
+            child.hold = hold;
+            child.curr = next < bot->n_pieces ? bot->pieces[next] : -1;
+            child.next = next + 1;
+            child.reward = node->reward + bot->clears[cleared];
+            child.score = child.reward + evaluate(bot, child.rows);
+            child.hash = hash_node(&child);
+            child.root = node->root;
+
+            if (bot->at_root) {
+                // Only one thread expands the root
+                if (bot->n_roots == bot->max_roots)
+                    continue;
+                BotRoot *r = &bot->roots[bot->n_roots];
+                r->hold = use_hold;
+                r->type = type;
+                r->len = search_path(&search, search.order[i], r->keys);
+                if (r->len < 0)
+                    continue;
+                child.root = bot->n_roots++;
+            }
+
+            int at = __atomic_fetch_add(&bot->n_children, 1, __ATOMIC_RELAXED);
+            if (at < bot->max_children)
+                bot->children[at] = child;
+        }
+    }
+}
+
+static void drain(Bot *bot, Piece *root_curr) {
+    int i;
+    while ((i = __atomic_fetch_add(&bot->next, 1, __ATOMIC_RELAXED)) < bot->n_nodes)
+        expand(bot, i, root_curr);
+}
+
+static void *worker_main(void *arg) {
+    Bot *bot = ((BotWorker *) arg)->bot;
+    uint32_t seen = 0;
+
+    pthread_mutex_lock(&bot->lock);
+    while (1) {
+        while (!bot->quit && bot->generation == seen)
+            pthread_cond_wait(&bot->work, &bot->lock);
+        if (bot->quit)
+            break;
+        seen = bot->generation;
+        pthread_mutex_unlock(&bot->lock);
+
+        // Workers only expand below the root, which the caller does alone
+        drain(bot, NULL);
+
+        pthread_mutex_lock(&bot->lock);
+        if (--bot->busy == 0)
+            pthread_cond_signal(&bot->done);
+    }
+    pthread_mutex_unlock(&bot->lock);
+    return NULL;
+}
+
+// Best first, ties broken by content so thread timing never changes a pick
+static int compare_nodes(const void *a, const void *b) {
+    const BotNode *x = a;
+    const BotNode *y = b;
+    if (x->score != y->score)
+        return x->score > y->score ? -1 : 1;
+    if (x->root != y->root)
+        return x->root < y->root ? -1 : 1;
+    return memcmp(x->rows, y->rows, sizeof(x->rows));
+}
+
+int bot_init(Bot *bot, Config *config) {
+    memset(bot, 0, sizeof(*bot));
+    bot->depth = config->bot_depth ? config->bot_depth : 1;
+    if (bot->depth > BOT_PREVIEW + 1)
+        bot->depth = BOT_PREVIEW + 1;
+    bot->beam = config->bot_beam ? config->bot_beam : 1;
+    bot->holes = config->bot_holes;
+    bot->bump = config->bot_bump;
+    bot->height = config->bot_height;
+    bot->wells = config->bot_wells;
+    memcpy(bot->clears, config->bot_clears, sizeof(bot->clears));
+
+    bot->max_children = bot->beam * 2 * BOT_MAX_LANDINGS;
+    bot->max_roots = 2 * BOT_MAX_LANDINGS;
+    bot->nodes = malloc(bot->beam * sizeof(BotNode));
+    bot->children = malloc(bot->max_children * sizeof(BotNode));
+    bot->roots = malloc(bot->max_roots * sizeof(BotRoot));
+    if (!bot->nodes || !bot->children || !bot->roots) {
+        bot_free(bot);
+        return -1;
+    }
+
+    pthread_mutex_init(&bot->lock, NULL);
+    pthread_cond_init(&bot->work, NULL);
+    pthread_cond_init(&bot->done, NULL);
+
+    // The calling thread expands too
+    int threads = config->bot_threads ? (int) config->bot_threads : sysconf(_SC_NPROCESSORS_ONLN);
+    bot->workers = calloc(threads > 1 ? threads - 1 : 1, sizeof(BotWorker));
+    for (int i = 0; bot->workers && i < threads - 1; i++) {
+        bot->workers[i].bot = bot;
+        if (pthread_create(&bot->workers[i].thread, NULL, worker_main, &bot->workers[i]))
+            break;
+        bot->n_workers++;
+    }
+    return 0;
+}
+
+void bot_free(Bot *bot) {
+    if (bot->workers) {
+        pthread_mutex_lock(&bot->lock);
+        bot->quit = 1;
+        pthread_cond_broadcast(&bot->work);
+        pthread_mutex_unlock(&bot->lock);
+        for (int i = 0; i < bot->n_workers; i++)
+            pthread_join(bot->workers[i].thread, NULL);
+        pthread_mutex_destroy(&bot->lock);
+        pthread_cond_destroy(&bot->work);
+        pthread_cond_destroy(&bot->done);
+    }
+    free(bot->workers);
+    free(bot->nodes);
+    free(bot->children);
+    free(bot->roots);
+    memset(bot, 0, sizeof(*bot));
+}
+
+// Expands every node of the beam on the pool, then keeps the best distinct
+// children as the next beam
+static void step(Bot *bot, Piece *root_curr) {
+    bot->n_children = 0;
+    bot->next = 0;
+    if (bot->at_root || !bot->n_workers) {
+        drain(bot, root_curr);
+    } else {
+        pthread_mutex_lock(&bot->lock);
+        bot->busy = bot->n_workers;
+        bot->generation++;
+        pthread_cond_broadcast(&bot->work);
+        pthread_mutex_unlock(&bot->lock);
+
+        drain(bot, NULL);
+
+        pthread_mutex_lock(&bot->lock);
+        while (bot->busy)
+            pthread_cond_wait(&bot->done, &bot->lock);
+        pthread_mutex_unlock(&bot->lock);
+    }
+
+    int n = bot->n_children < bot->max_children ? bot->n_children : bot->max_children;
+    qsort(bot->children, n, sizeof(BotNode), compare_nodes);
+
+    bot->n_nodes = 0;
+    for (int i = 0; i < n && bot->n_nodes < bot->beam; i++) {
+        BotNode *c = &bot->children[i];
+        int8_t dup = 0;
+        for (int j = 0; j < bot->n_nodes && !dup; j++)
+            dup = bot->nodes[j].hash == c->hash
+               && !memcmp(bot->nodes[j].rows, c->rows, sizeof(c->rows));
+        if (!dup)
+            bot->nodes[bot->n_nodes++] = *c;
+    }
+}
+
+// Adds a press and release of key, holding it for hold ns
+static void tap(BotMove *move, int8_t key, uint64_t *time, uint64_t hold) {
+    if (move->n + 2 > BOT_MAX_EVENTS)
+        return;
+    move->ev[move->n++] = (BotEvent) { *time, key, 1 };
+    *time += hold;
+    move->ev[move->n++] = (BotEvent) { *time, key, 0 };
+    *time += CORE_RES;
+}
+
+// Turns a path into transitions, held shifts become taps so the bot never
+// waits out DAS, soft drop is held for as long as the drop takes
+static void build_move(GameState *s, BotRoot *r, BotMove *move) {
+    Board board;
+    memcpy(board.rows, s->board.rows, sizeof(board.rows));
+    uint64_t time = 0;
+    move->n = 0;
+
+    Piece p = s->curr;
+    if (r->hold) {
+        tap(move, HOLD, &time, CORE_RES);
+        gen_piece(&p, r->type);
+    }
+
+    for (int8_t i = 0; i < r->len; i++) {
+        int8_t key = r->keys[i];
+        Piece before = p;
+        search_press(&board, &p, key);
+
+        if (key == DAS_LEFT || key == DAS_RIGHT) {
+            int8_t dir = key == DAS_LEFT ? LEFT : RIGHT;
+            for (int8_t j = abs(p.x - before.x); j > 0; j--)
+                tap(move, dir, &time, CORE_RES);
+        } else if (key == SD) {
+            uint64_t hold = (before.y - p.y) * s->handling.sd_interval;
+            tap(move, SD, &time, hold > CORE_RES ? hold : CORE_RES);
+        } else {
+            tap(move, key, &time, CORE_RES);
+        }
+    }
+    tap(move, HD, &time, CORE_RES);
+}
+
+int bot_think(Bot *bot, GameState *s, BotMove *move) {
+    bot->pieces[0] = s->curr.type;
+    for (int8_t i = 1; i <= BOT_PREVIEW; i++)
+        bot->pieces[i] = s->queue[(s->queue_pos + i - 1) % BAG_SZ];
+    bot->n_pieces = BOT_PREVIEW + 1;
+    bot->hold_used = s->hold_used;
+
+    BotNode *root = &bot->nodes[0];
+    memcpy(root->rows, s->board.rows, sizeof(root->rows));
+    root->curr = s->curr.type;
+    root->hold = s->hold;
+    root->next = 1;
+    root->root = -1;
+    root->reward = 0;
+    root->score = 0;
+    bot->n_nodes = 1;
+    bot->n_roots = 0;
+
+    // The best line at the deepest level reached decides the first move
+    int16_t best = -1;
+    for (int d = 0; d < bot->depth; d++) {
+        bot->at_root = d == 0;
+        step(bot, &s->curr);
+        if (!bot->n_nodes)
+            break;
+        best = bot->nodes[0].root;
+    }
+    bot->at_root = 0;
+
+    if (best < 0)
+        return 0;
+    build_move(s, &bot->roots[best], move);
+    return 1;
+}
@@ -1,45 +1,84 @@
 #include "config.h"
+#include "bot.h"
+#include "core.h"
+#include "timing.h"
+#include <poll.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 #include <ini.h>
 
-void config_init_extkeys(Config *config) {
-    config->left  = 260;
-    config->right = 261;
-    config->sd    = 258;
-    config->hd    = ' ';
-    config->ccw   = 'a';
-    config->cw    = 's';
-    config->flip  = 'd';
-    config->hold  = 57441;
-    config->reset = 'r';
-    config->quit  = 'q';
+// Default key for each action, in the order of the action numbers
+static const uint32_t default_keys[MODES][KEYS] = {
+    [EXTKEYS]   = { 260, 261, 258, ' ', 'a', 's', 'd', 57441, 'r', 'q', 'p' },
+    [SCANCODES] = { 0x4b, 0x4d, 0x50, 0x39, 0x1e, 0x1f, 0x20, 0x2a, 0x13, 0x10, 0x19 },
+    [NORM]      = { 'D', 'C', 'B', ' ', 'a', 's', 'd', 'z', 'r', 'q', 'p' },
+    // Linux KEY_ codes, as in linux/input-event-codes.h
+    [EVDEV]     = { 105, 106, 108, 57, 30, 31, 32, 42, 19, 16, 25 },
+};
+
+// Section for each input mode and key for each action in the ini
+static const char *mode_sections[MODES] = {
+    [EXTKEYS] = "extkeys",
+    [SCANCODES] = "scan",
+    [NORM] = "norm",
+    [EVDEV] = "evdev",
+};
+
+static const char *action_names[KEYS] = {
+    "left", "right", "sd", "hd", "ccw", "cw", "180", "hold", "reset", "quit", "solve"
+};
+
+void config_init_keys(Config *config) {
+    memset(config->binds, 0, sizeof(config->binds));
+    for (int m = 0; m < MODES; m++)
+        for (int i = 0; i < KEYS; i++)
+            config->binds[m][i][0] = default_keys[m][i];
 }
 
-void config_init_scan(Config *config) {
-    config->left  = 0x4b;
-    config->right = 0x4d;
-    config->sd    = 0x50;
-    config->hd    = 0x39;
-    config->ccw   = 0x1e;
-    config->cw    = 0x1f;
-    config->flip  = 0x20;
-    config->hold  = 0x2a;
-    config->reset = 0x13;
-    config->quit  = 0x10;
+// A comma separated list of up to BINDS keys, in decimal or 0x hex
+static int parse_binds(uint32_t binds[BINDS], const char *value) {
+    uint32_t keys[BINDS] = { 0 };
+    int n = 0;
+    while (*value) {
+        char *end;
+        unsigned long key = strtoul(value, &end, 0);
+        if (end == value || n == BINDS)
+            return 0;
+        keys[n++] = key;
+        while (*end == ' ' || *end == ',')
+            end++;
+        value = end;
+    }
+    memcpy(binds, keys, sizeof(keys));
+    return 1;
+}
+
+// Comma separated cells per frame for each level, GRAVITY_20G or more
+// drops straight to the stack
+static int parse_gravity(Config *config, const char *value) {
+    uint32_t gravity[LEVELS];
+    int n = 0;
+    while (*value) {
+        char *end;
+        double g = strtod(value, &end);
+        if (end == value || n == LEVELS || g <= 0)
+            return 0;
+        double ns = NS_PER_SEC / (g * FPS);
+        gravity[n++] = g >= GRAVITY_20G ? 0 : ns > UINT32_MAX ? UINT32_MAX : ns;
+        while (*end == ' ' || *end == ',')
+            end++;
+        value = end;
+    }
+    memcpy(config->gravity, gravity, n * sizeof(*gravity));
+    config->levels = n;
+    return 1;
 }
 
-void config_init_norm(Config *config) {
-    config->left  = 'D';
-    config->right = 'C';
-    config->sd    = 'B';
-    config->hd    = ' ';
-    config->ccw   = 'a';
-    config->cw    = 's';
-    config->flip  = 'd';
-    config->hold  = 'z';
-    config->reset = 'r';
-    config->quit  = 'q';
+static void config_init_game(Config *config) {
+    config->countdown = 1000;
+    core_defaults(config);
 }
 
 static int handler(void* user, const char* section, const char* name,
@@ -47,40 +86,56 @@ static int handler(void* user, const char* section, const char* name,
     Config *config = (Config*) user;
 
     #define MATCH(s, n) (strcmp(section, s) == 0 && strcmp(name, n) == 0)
-    char *mode_section = NULL;
-
-    switch (config->mode) {
-    case EXTKEYS:
-        mode_section = "extkeys";
-        break;
-    case SCANCODES:
-        mode_section = "scan";
-        break;
-    case NORM:
-        mode_section = "norm";
-        break;
+
+    for (int m = 0; m < MODES; m++) {
+        if (strcmp(section, mode_sections[m]))
+            continue;
+        for (int i = 0; i < KEYS; i++)
+            if (!strcmp(name, action_names[i]))
+                return parse_binds(config->binds[m][i], value);
+        return 0;
     }
 
-    if (MATCH(mode_section, "left")) {
-        config->left = atoi(value);
-    } else if (MATCH(mode_section, "right")) {
-        config->right = atoi(value);
-    } else if (MATCH(mode_section, "sd")) {
-        config->sd = atoi(value);
-    } else if (MATCH(mode_section, "hd")) {
-        config->hd = atoi(value);
-    } else if (MATCH(mode_section, "ccw")) {
-        config->ccw = atoi(value);
-    } else if (MATCH(mode_section, "cw")) {
-        config->cw = atoi(value);
-    } else if (MATCH(mode_section, "180")) {
-        config->flip = atoi(value);
-    } else if (MATCH(mode_section, "hold")) {
-        config->hold = atoi(value);
-    } else if (MATCH(mode_section, "reset")) {
-        config->reset = atoi(value);
-    } else if (MATCH(mode_section, "quit")) {
-        config->quit = atoi(value);
+    if (MATCH("handling", "das")) {
+        config->das = atoi(value);
+    } else if (MATCH("handling", "arr")) {
+        config->arr = atoi(value);
+    } else if (MATCH("handling", "sdf")) {
+        config->sdf = atoi(value);
+    } else if (MATCH("game", "countdown")) {
+        config->countdown = atoi(value);
+    } else if (MATCH("game", "lock")) {
+        config->lock = atoi(value);
+    } else if (MATCH("game", "lock_resets")) {
+        config->lock_resets = atoi(value);
+    } else if (MATCH("game", "level")) {
+        config->level = atoi(value);
+    } else if (MATCH("game", "gravity")) {
+        return parse_gravity(config, value);
+    } else if (MATCH("bot", "threads")) {
+        config->bot_threads = atoi(value);
+    } else if (MATCH("bot", "depth")) {
+        config->bot_depth = atoi(value);
+    } else if (MATCH("bot", "beam")) {
+        config->bot_beam = atoi(value);
+    } else if (MATCH("bot", "pps")) {
+        config->bot_pps = atoi(value);
+    } else if (MATCH("bot", "holes")) {
+        config->bot_holes = atoi(value);
+    } else if (MATCH("bot", "bumpiness")) {
+        config->bot_bump = atoi(value);
+    } else if (MATCH("bot", "height")) {
+        config->bot_height = atoi(value);
+    } else if (MATCH("bot", "wells")) {
+        config->bot_wells = atoi(value);
+    } else if (MATCH("bot", "clear1")) {
+        config->bot_clears[1] = atoi(value);
+    } else if (MATCH("bot", "clear2")) {
+        config->bot_clears[2] = atoi(value);
+    } else if (MATCH("bot", "clear3")) {
+        config->bot_clears[3] = atoi(value);
+    } else if (MATCH("bot", "clear4")) {
+        config->bot_clears[4] = atoi(value);
     } else {
         return 0;
     }
@@ -102,20 +157,123 @@ void get_config_path(char *config_path) {
     strcat(config_path, "/config.ini");
 }
 
-void config_init(Config *config) {
+// Defaults overridden by whatever the file sets, returns ini_parse's result
+static int config_load(Config *config) {
     char config_path[4096] = { 0 };
     get_config_path(config_path);
 
-    switch (config->mode) {
-    case EXTKEYS:
-        config_init_extkeys(config);
-        break;
-    case SCANCODES:
-        config_init_scan(config);
-        break;
-    case NORM:
-        config_init_norm(config);
-        break;
+    config_init_keys(config);
+    config_init_game(config);
+    bot_defaults(config);
+    int err = ini_parse(config_path, handler, config);
+    config_keymap(config);
+    return err;
+}
+
+void config_init(Config *config) {
+    config_load(config);
+}
+
+void config_keymap(Config *config) {
+    keymap_clear(&config->keymap);
+    for (int i = 0; i < KEYS; i++)
+        for (int j = 0; j < BINDS && config->binds[config->mode][i][j]; j++)
+            keymap_bind(&config->keymap, config->binds[config->mode][i][j], i);
+}
+
+static void *watch_main(void *arg) {
+    ConfigWatch *w = arg;
+    // Big enough for a few events with names
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfds[2] = {
+        { .fd = w->fd, .events = POLLIN },
+        { .fd = w->stop[0], .events = POLLIN },
+    };
+
+    while (poll(pfds, 2, -1) >= 0 && !pfds[1].revents) {
+        ssize_t len = read(w->fd, buf, sizeof(buf));
+        int8_t changed = 0;
+        for (char *p = buf; len > 0 && p < buf + len; ) {
+            struct inotify_event *e = (struct inotify_event *) p;
+            if (e->len && !strcmp(e->name, "config.ini"))
+                changed = 1;
+            p += sizeof(*e) + e->len;
+        }
+        if (!changed)
+            continue;
+
+        // A file that is gone or unreadable leaves the current config be,
+        // a missing key still falls back to its default
+        Config next = { 0 };
+        next.mode = w->mode;
+        if (config_load(&next) < 0)
+            continue;
+
+        pthread_mutex_lock(&w->lock);
+        w->next = next;
+        w->ready = 1;
+        pthread_mutex_unlock(&w->lock);
+    }
+    return NULL;
+}
+
+int config_watch(ConfigWatch *w, Config *config) {
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+    w->mode = config->mode;
+
+    char dir[4096] = { 0 };
+    get_config_path(dir);
+    char *slash = strrchr(dir, '/');
+    if (!slash)
+        return -1;
+    *slash = 0;
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    // Editors that save through a temporary file rename it over the old one
+    if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 || pipe(w->stop)) {
+        close(fd);
+        return -1;
     }
-    ini_parse(config_path, handler, config);
+    w->fd = fd;
+    pthread_mutex_init(&w->lock, NULL);
+    if (pthread_create(&w->thread, NULL, watch_main, w)) {
+        config_unwatch(w);
+        return -1;
+    }
+    return 0;
+}
+
+int config_reload(ConfigWatch *w, Config *config) {
+    if (w->fd < 0)
+        return 0;
+    int8_t ready = 0;
+    enum InputMode mode = config->mode;
+    pthread_mutex_lock(&w->lock);
+    if (w->ready) {
+        *config = w->next;
+        w->ready = 0;
+        ready = 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+    // The mode can change after the watch starts, if the cached one was wrong
+    if (ready && config->mode != mode) {
+        config->mode = mode;
+        config_keymap(config);
+    }
+    return ready;
+}
+
+void config_unwatch(ConfigWatch *w) {
+    if (w->fd < 0)
+        return;
+    if (w->thread && write(w->stop[1], "", 1) == 1)
+        pthread_join(w->thread, NULL);
+    pthread_mutex_destroy(&w->lock);
+    close(w->stop[0]);
+    close(w->stop[1]);
+    close(w->fd);
+    w->fd = -1;
 }
@@ -0,0 +1,352 @@
+#include <string.h>
+#include "core.h"
+#include "timing.h"
+
+// splitmix64, any seed (including 0) gives a full period stream
+uint32_t rng_next(uint64_t *rng) {
+    uint64_t z = (*rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31)) >> 32;
+}
+
+int8_t queue_pop(Piece *p, int8_t queue[], int8_t queue_pos, uint64_t *rng) {
+    gen_piece(p, queue[queue_pos]);
+
+    int8_t rand = rng_next(rng) % (BAG_SZ - queue_pos);
+    int8_t used[BAG_SZ] = {0};
+    int8_t bag[BAG_SZ];
+    int8_t bag_pos = 0;
+
+    for (int8_t i = 0; i < queue_pos; i++)
+        used[queue[i]] = 1;
+
+    for (int8_t i = 0; i < BAG_SZ; i++)
+        if (!used[i])
+            bag[bag_pos++] = i;
+
+    queue[queue_pos] = bag[rand];
+    return (queue_pos + 1) % BAG_SZ;
+
+}
+
+void queue_init(int8_t queue[], uint64_t *rng) {
+    int8_t bag[BAG_SZ];
+    for (int8_t i = 0; i < BAG_SZ; i++)
+        bag[i] = i;
+
+    for (int8_t i = BAG_SZ - 1; i > 0; i--) {
+        int8_t rand = rng_next(rng) % (i + 1);
+        queue[BAG_SZ - 1 - i] = bag[rand];
+        bag[rand] = bag[i];
+    }
+
+    queue[BAG_SZ - 1] = bag[0];
+}
+
+void core_defaults(Config *config) {
+    config->das = 100;
+    config->arr = 0;
+    config->sdf = 0;
+    config->lock = 500;
+    config->lock_resets = 15;
+    config->level = 1;
+    config->levels = 0;
+}
+
+// Gravity for the level the game is on
+static void set_level(GameState *s) {
+    int n = s->level <= s->levels ? s->level - 1 : s->levels - 1;
+    s->grav_interval = s->gravity[n];
+    handling_gravity(&s->handling, s->grav_interval);
+}
+
+void core_init(GameState *s, Config *config, uint32_t seed) {
+    memset(s, 0, sizeof(*s));
+    s->hold = -1;
+    s->rng = seed;
+    queue_init(s->queue, &s->rng);
+
+    s->levels = config->levels;
+    memcpy(s->gravity, config->gravity, sizeof(s->gravity));
+    if (!s->levels) {
+        s->gravity[0] = NS_PER_SEC / (GRAVITY * FPS);
+        s->levels = 1;
+    }
+    s->level = config->level ? config->level : 1;
+    handling_init(&s->handling, config, s->gravity[0]);
+    set_level(s);
+
+    s->lock_delay = config->lock * NS_PER_MS;
+    s->lock_resets = config->lock_resets;
+}
+
+// Starts lock delay when the piece touches down and restarts it for moves
+// on the ground, a new lowest row gives back every reset
+static void ground(GameState *s, uint64_t time, int8_t moved) {
+    int8_t lower = s->curr.y < s->lock_low;
+    if (lower) {
+        s->lock_low = s->curr.y;
+        s->resets = 0;
+    }
+    if (s->drop) {
+        s->grounded = 0;
+        return;
+    }
+    if (lower || ((moved || !s->grounded) && s->resets < s->lock_resets)) {
+        s->resets += !lower;
+        s->lock_start = time;
+    }
+    s->grounded = 1;
+}
+
+// Moves the piece down up to n cells, as far as drop allows
+static void fall(GameState *s, int8_t n, uint64_t time) {
+    if (n > s->drop)
+        n = s->drop;
+    if (n <= 0)
+        return;
+    s->curr.y -= n;
+    for (int8_t i = 0; i < 4; i++)
+        s->curr.coords[i][1] -= n;
+    s->drop -= n;
+    ground(s, time, 0);
+}
+
+// After the piece moved or spun, or a new one spawned (moved is 0), 20G
+// puts it straight back on the stack
+static void piece_moved(GameState *s, uint64_t time, int8_t moved) {
+    s->drop = drop_distance(&s->board, s->cols, &s->curr);
+    ground(s, time, moved);
+    if (!s->grav_interval)
+        fall(s, s->drop, time);
+}
+
+static void shift_piece(GameState *s, int8_t amount, uint64_t time) {
+    if (!amount)
+        return;
+    int8_t x = s->curr.x;
+    move_piece(&s->board, &s->curr, 1, amount);
+    if (s->curr.x != x)
+        piece_moved(s, time, 1);
+}
+
+static void spin(GameState *s, int8_t dir, uint64_t time) {
+    int8_t rot = s->curr.rot;
+    spin_piece(&s->board, &s->curr, dir);
+    if (s->curr.rot != rot)
+        piece_moved(s, time, 1);
+}
+
+static void new_piece(GameState *s, uint64_t time) {
+    s->hold_used = 0;
+    s->piece_keys = 0;
+    s->grav_start = time;
+    s->grav_dropped = 0;
+    s->lock_low = ARR_HEIGHT;
+    s->resets = 0;
+    s->grounded = 0;
+    handling_new_piece(&s->handling, time);
+    piece_moved(s, time, 0);
+}
+
+void core_start(GameState *s) {
+    s->queue_pos = queue_pop(&s->curr, s->queue, 0, &s->rng);
+    new_piece(s, 0);
+}
+
+static void lock(GameState *s, uint64_t time);
+
+// Auto-shift, soft drop, gravity and lock delay due by time
+static void update(GameState *s, uint64_t time) {
+    shift_piece(s, handling_shift(&s->handling, time), time);
+    fall(s, handling_drop(&s->handling, time), time);
+
+    // Every cell due is one step, however many there are
+    if (s->grav_interval) {
+        uint32_t due = (time - s->grav_start) / s->grav_interval;
+        if (due != s->grav_dropped) {
+            uint32_t n = due - s->grav_dropped;
+            fall(s, n < ARR_HEIGHT ? n : ARR_HEIGHT, time);
+            s->grav_dropped = due;
+        }
+    }
+
+    if (s->lock_delay && s->grounded && time >= s->lock_start + s->lock_delay)
+        lock(s, time);
+}
+
+void core_advance(GameState *s, uint64_t time) {
+    time -= time % CORE_RES;
+    if (s->done || time <= s->time)
+        return;
+    for (uint64_t t = (s->time / CORE_TICK + 1) * CORE_TICK; t <= time && !s->done; t += CORE_TICK)
+        update(s, t);
+    s->time = time;
+}
+
+// Lines sent for clearing 0 to 4 at once
+static const int8_t attack[5] = { 0, 0, 1, 2, 4 };
+
+// Clears cancel waiting garbage before anything is sent, and garbage only
+// rises under a piece that cleared nothing
+static void send_garbage(GameState *s, int8_t lines) {
+    int8_t out = attack[lines];
+    while (out && s->n_garbage) {
+        int8_t n = out < s->garbage[0] ? out : s->garbage[0];
+        out -= n;
+        s->garbage[0] -= n;
+        if (!s->garbage[0]) {
+            s->n_garbage--;
+            memmove(s->garbage, s->garbage + 1, s->n_garbage);
+            memmove(s->garbage_holes, s->garbage_holes + 1, s->n_garbage);
+        }
+    }
+    s->sent += out;
+    if (lines)
+        return;
+    for (int8_t i = 0; i < s->n_garbage; i++)
+        add_garbage(&s->board, s->garbage[i], s->garbage_holes[i]);
+    s->n_garbage = 0;
+}
+
+// In versus a piece that comes out inside the stack loses the game
+static int8_t top_out(GameState *s, uint64_t time) {
+    s->topped_out = s->versus && check_collide(&s->board, s->curr.x, s->curr.y, s->curr.type, s->curr.rot);
+    if (s->topped_out) {
+        s->done = 1;
+        s->end_time = time;
+    }
+    return s->topped_out;
+}
+
+// Locks the piece where it is and brings in the next one
+static void lock(GameState *s, uint64_t time) {
+    int8_t best = finesse_check(&s->board, &s->curr, &s->finesse);
+    s->last_keys = s->piece_keys;
+    s->fault = best >= 0 && s->piece_keys > best;
+    s->faults += s->fault;
+    lock_piece(&s->board, &s->curr);
+    int8_t lines = clear_lines(&s->board);
+    s->cleared += lines;
+    while (s->n_splits < SPLITS && s->cleared >= (s->n_splits + 1) * SPLIT_LINES)
+        s->splits[s->n_splits++] = time;
+    send_garbage(s, lines);
+    board_columns(&s->board, s->cols);
+    int up = s->cleared / LEVEL_LINES - (s->cleared - lines) / LEVEL_LINES;
+    if (up) {
+        s->level += up;
+        set_level(s);
+    }
+    s->queue_pos = queue_pop(&s->curr, s->queue, s->queue_pos, &s->rng);
+    new_piece(s, time);
+    s->pieces++;
+    s->keys += s->keys_tmp;
+    s->keys_tmp = 0;
+    if (!top_out(s, time) && s->cleared >= CLEAR_GOAL) {
+        s->done = 1;
+        s->end_time = time;
+    }
+}
+
+static void hard_drop(GameState *s, uint64_t time) {
+    fall(s, s->drop, time);
+    lock(s, time);
+}
+
+// Once per piece, a refused hold leaves the piece and its lock delay alone
+static void hold(GameState *s, uint64_t time) {
+    if (s->hold_used)
+        return;
+    if (s->hold == -1) {
+        s->hold = s->curr.type;
+        s->queue_pos = queue_pop(&s->curr, s->queue, s->queue_pos, &s->rng);
+        s->holds++;
+    } else {
+        int8_t tmp = s->hold;
+        s->hold = s->curr.type;
+        gen_piece(&s->curr, tmp);
+        s->holds++;
+    }
+    new_piece(s, time);
+    s->hold_used = 1;
+    top_out(s, time);
+}
+
+void core_input(GameState *s, int8_t key, int8_t pressed, uint64_t time) {
+    if (pressed)
+        s->inputs |= 1 << key;
+    else
+        s->inputs &= ~(1 << key);
+    if (s->done)
+        return;
+
+    time -= time % CORE_RES;
+    if (time < s->time)
+        time = s->time;
+    core_advance(s, time);
+    update(s, time);
+    // Lock delay can end the game on the way
+    if (s->done)
+        return;
+
+    if (key == LEFT || key == RIGHT) {
+        int8_t dir = key == LEFT ? -1 : 1;
+        shift_piece(s, handling_shift_key(&s->handling, dir, pressed, time), time);
+    } else if (key == SD) {
+        handling_sd_key(&s->handling, pressed, time);
+    }
+
+    if (!pressed)
+        return;
+    if (key < HOLD + 1)
+        s->keys_tmp++;
+    if (key < HOLD)
+        s->piece_keys++;
+
+    switch (key) {
+    case HD:
+        hard_drop(s, time);
+        break;
+    case CCW:
+        spin(s, 2, time);
+        break;
+    case CW:
+        spin(s, 0, time);
+        break;
+    case FLIP:
+        spin(s, 1, time);
+        break;
+    case HOLD:
+        hold(s, time);
+        break;
+    }
+}
+
+void core_garbage(GameState *s, int8_t lines, int8_t hole) {
+    if (lines <= 0 || (uint8_t) hole >= BOARD_WIDTH)
+        return;
+    // Past the limit it piles onto the newest batch
+    if (s->n_garbage == GARBAGE_MAX) {
+        int n = s->garbage[GARBAGE_MAX - 1] + lines;
+        s->garbage[GARBAGE_MAX - 1] = n > ARR_HEIGHT ? ARR_HEIGHT : n;
+        return;
+    }
+    s->garbage[s->n_garbage] = lines;
+    s->garbage_holes[s->n_garbage++] = hole;
+}
+
+int core_pending(GameState *s) {
+    int n = 0;
+    for (int8_t i = 0; i < s->n_garbage; i++)
+        n += s->garbage[i];
+    return n;
+}
+
+void core_step(GameState *s, uint16_t inputs) {
+    uint16_t changed = inputs ^ s->inputs;
+    for (int8_t i = 0; i < KEYS; i++)
+        if (changed & (1 << i))
+            core_input(s, i, (inputs >> i) & 1, s->time);
+    core_advance(s, s->time + NS_PER_SEC / FPS);
+}
@@ -0,0 +1,532 @@
+#include <curses.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include "draw.h"
+#include "timing.h"
+
+#define COLOR_ORANGE 8
+
+// Key overlay labels, indexed by key then DAS_LEFT and DAS_RIGHT
+static const char *key_chars[DAS_RIGHT + 1] = {
+    "←",
+    "→",
+    "↓",
+    "▼",
+    "(",
+    ")",
+    "/",
+    "↕",
+    "",
+    "",
+    "",
+    "⇇",
+    "⇉"
+};
+
+// Set when drawing goes through the ANSI renderer instead of curses
+static AnsiScreen *ansi;
+
+void init_curses () {
+    initscr();
+    raw();
+    curs_set(0);
+    noecho();
+    nodelay(stdscr, 1);
+    init_curses_colors();
+}
+
+void init_curses_colors() {
+    start_color();
+    use_default_colors();
+
+    // Base pieces
+    init_pair(1,  COLOR_CYAN,    -1);
+    init_pair(2,  COLOR_BLUE,    -1);
+    init_pair(3,  COLOR_WHITE,   -1);
+    init_pair(4,  COLOR_YELLOW,  -1);
+    init_pair(5,  COLOR_GREEN,   -1);
+    init_pair(6,  COLOR_MAGENTA, -1);
+    init_pair(7,  COLOR_RED,     -1);
+
+    // End screen board + pressed key bg
+    init_pair(8,  COLOR_WHITE,   -1);
+
+    // Pressed key text
+    init_pair(9,  COLOR_BLUE,    COLOR_WHITE);
+
+    // Base key text
+    init_pair(10, COLOR_WHITE,   COLOR_BLUE);
+
+    // Base key bg
+    init_pair(11, COLOR_BLUE,    -1);
+
+    // Make orange if supported
+    if (COLORS > 8) {
+        init_color(COLOR_ORANGE, 816, 529, 439);
+        init_pair(3,  COLOR_ORANGE,  -1);
+    }
+}
+
+void draw_use_ansi(AnsiScreen *scr) {
+    ansi = scr;
+    if (!scr)
+        return;
+
+    // The same pairs as init_curses_colors
+    ansi_pair(scr, 1,  "36");
+    ansi_pair(scr, 2,  "34");
+    ansi_pair(scr, 3,  COLORS > 8 ? "38;5;173" : "37");
+    ansi_pair(scr, 4,  "33");
+    ansi_pair(scr, 5,  "32");
+    ansi_pair(scr, 6,  "35");
+    ansi_pair(scr, 7,  "31");
+    ansi_pair(scr, 8,  "37");
+    ansi_pair(scr, 9,  "34;47");
+    ansi_pair(scr, 10, "37;44");
+    ansi_pair(scr, 11, "34");
+    ansi_clear(scr);
+}
+
+int8_t panel_changed(Panel *panel, const void *key, size_t len) {
+    if (len > sizeof(panel->key)) {
+        panel->valid = 0;
+        return 1;
+    }
+    if (panel->valid && panel->len == len && !memcmp(panel->key, key, len))
+        return 0;
+    memcpy(panel->key, key, len);
+    panel->len = len;
+    panel->valid = 1;
+    return 1;
+}
+
+void panel_init(Panel *panel, int h, int w, int y, int x) {
+    panel->w = ansi ? NULL : newwin(h, w, y, x);
+    panel->y = y;
+    panel->x = x;
+    panel->h = h;
+    panel->cols = w;
+    panel->valid = 0;
+}
+
+void panel_free(Panel *panel) {
+    if (panel->w)
+        delwin(panel->w);
+    panel->w = NULL;
+}
+
+static void panel_erase(Panel *panel) {
+    if (ansi)
+        ansi_fill(ansi, panel->y, panel->x, panel->h, panel->cols);
+    else
+        werase(panel->w);
+}
+
+// Puts s at (y, x) in colour pair with attr (A_REVERSE or 0) and returns
+// the column after it
+static int panel_puts(Panel *panel, int y, int x, int pair, attr_t attr, const char *s) {
+    // Outside the panel, as curses would refuse it
+    if (ansi && (y < 0 || y >= panel->h || x < 0))
+        return x;
+    if (ansi)
+        return ansi_puts(ansi, panel->y + y, panel->x + x, panel->x + panel->cols, pair,
+            attr & A_REVERSE ? ANSI_REVERSE : 0, s) - panel->x;
+
+    WINDOW *w = panel->w;
+    wattron(w, COLOR_PAIR(pair) | attr);
+    mvwaddstr(w, y, x, s);
+    wattroff(w, COLOR_PAIR(pair) | attr);
+    return getcurx(w);
+}
+
+static int panel_printf(Panel *panel, int y, int x, int pair, attr_t attr, const char *fmt, ...) {
+    char buf[128];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return panel_puts(panel, y, x, pair, attr, buf);
+}
+
+// Stages the panel for the next draw_flush
+static void panel_done(Panel *panel) {
+    if (!ansi)
+        wnoutrefresh(panel->w);
+}
+
+void panel_blank(Panel *panel) {
+    panel_erase(panel);
+    panel_done(panel);
+    panel->valid = 0;
+}
+
+void draw_flush() {
+    if (ansi)
+        ansi_flush(ansi);
+    else
+        doupdate();
+}
+
+void draw_text(int y, int x, const char *s) {
+    if (ansi) {
+        ansi_puts(ansi, y, x, ansi->cols, 0, 0, s);
+        ansi_flush(ansi);
+    } else {
+        mvaddstr(y, x, s);
+        refresh();
+    }
+}
+
+void draw_clear() {
+    if (ansi)
+        ansi_clear(ansi);
+    else
+        clear();
+}
+
+void draw_resize() {
+    struct winsize ws;
+    if (ioctl(ansi ? ansi->fd : STDOUT_FILENO, TIOCGWINSZ, &ws) || !ws.ws_row || !ws.ws_col)
+        return;
+    if (ws.ws_row == LINES && ws.ws_col == COLS)
+        return;
+    if (!ansi || !ansi_resize(ansi, ws.ws_row, ws.ws_col))
+        resizeterm(ws.ws_row, ws.ws_col);
+}
+
+void draw_gui(int8_t x, int8_t y) {
+    Panel screen = { .h = LINES, .cols = COLS };
+    if (!ansi)
+        screen.w = stdscr;
+
+    for (int8_t i = BOARD_HEIGHT - 1; i >= 0; i--) {
+        panel_puts(&screen, y + i, x, 0, 0, "█");
+        panel_puts(&screen, y + i, x + 1 + BOARD_WIDTH * 2, 0, 0, "█");
+    }
+    for (int8_t i = 0; i < BOARD_WIDTH + 1; i++)
+        panel_puts(&screen, y + BOARD_HEIGHT, x + i * 2, 0, 0, "▀▀");
+    if (ansi)
+        ansi_flush(ansi);
+    else
+        refresh();
+}
+
+void draw_piece(Panel *panel, int8_t x, int8_t y, int8_t type, int8_t rot, int8_t ghost) {
+    for (int8_t i = 0; i < 4; i++) {
+        panel_puts(panel,
+                   y + pieces[type][rot][i][1],
+                   2 * (x + pieces[type][rot][i][0]),
+                   type + 1, 0,
+                   ghost ? "▓▓" : "██"
+        );
+    }
+}
+
+void draw_board(Panel *panel, Board *board, const Piece *p, int8_t line, int8_t mono) {
+    struct {
+        uint32_t version;
+        int8_t x, y, type, rot, line, mono;
+    } key = { board->version, p->x, p->y, p->type, p->rot, line, mono };
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, &key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+
+    // Found on a copy, the game keeps the piece's cells between moves
+    Piece ghost = *p;
+    move_piece(board, &ghost, 0, -ghost.y);
+    int8_t ghost_y = ghost.y;
+
+    for (int8_t i = 0; i < BOARD_HEIGHT; i++) {
+        for (int8_t j = 0; j < BOARD_WIDTH; j++) {
+            if (board->rows[i] & (1 << j)) {
+                panel_puts(panel, BOARD_HEIGHT - 1 - i, 2 * j,
+                    mono ? 8 : board->colors[i][j], 0, mono ? "▓▓" : "██");
+            } else if (i == line) {
+                panel_puts(panel, BOARD_HEIGHT - 1 - i, 2 * j, 0, 0, "__");
+            }
+        }
+    }
+
+    if (!mono) {
+        draw_piece(panel, p->x, BOARD_HEIGHT - 1 - ghost_y, p->type, p->rot, 1);
+        draw_piece(panel, p->x, BOARD_HEIGHT - 1 - p->y, p->type, p->rot, 0);
+    }
+    panel_done(panel);
+}
+
+void draw_queue(Panel *panel, int8_t queue[], int8_t queue_pos) {
+    int8_t key[QUEUE_SZ];
+    for (int8_t i = 0; i < QUEUE_SZ; i++)
+        key[i] = queue[(queue_pos + i) % BAG_SZ];
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+    for (int8_t i = 0; i < QUEUE_SZ; i++)
+        draw_piece(panel, 1, 2 + 3 * i, key[i], 0, 0);
+    panel_done(panel);
+}
+
+void draw_hold(Panel *panel, int8_t p, int8_t held) {
+    int8_t key[2] = { p, held };
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+    if (p != -1) {
+        draw_piece(panel, 1, 1, p, 0, held);
+    }
+    panel_done(panel);
+}
+
+void draw_keys(Panel *panel, uint16_t inputs) {
+    // Only the keys drawn matter for redraws
+    inputs &= (1 << (HOLD + 1)) - 1;
+    PANEL_KEY_FITS(inputs);
+    if (!panel_changed(panel, &inputs, sizeof(inputs)))
+        return;
+
+    panel_erase(panel);
+    // by top left corner (y, x)
+    const int key_pos[HOLD + 1][2] = {
+        { 4, 23 },
+        { 4, 28 },
+        { 4, 33 },
+        { 4, 15 },
+        { 0,  5 },
+        { 0, 10 },
+        { 0, 15 },
+        { 2,  0 },
+    };
+
+    // base key display, pressed keys light up
+    for (int i = 0; i < HOLD + 1; i++) {
+        int pressed = (inputs >> i) & 1;
+        int bg = pressed ? 8 : 11;
+        int text = pressed ? 9 : 10;
+        panel_puts(panel, key_pos[i][0]    , key_pos[i][1], bg, 0, "▄▄▄▄▄");
+        panel_puts(panel, key_pos[i][0] + 2, key_pos[i][1], bg, 0, "▀▀▀▀▀");
+        int x = panel_puts(panel, key_pos[i][0] + 1, key_pos[i][1], text, 0, "  ");
+        x = panel_puts(panel, key_pos[i][0] + 1, x, text, 0, key_chars[i]);
+        panel_puts(panel, key_pos[i][0] + 1, x, text, 0, "  ");
+    }
+
+    panel_done(panel);
+}
+
+// Centiseconds as s.cc, or m:ss.cc from a minute up
+static void format_csecs(char *out, size_t len, int csecs) {
+    int min = csecs / 6000;
+    int sec = (csecs / 100) % 60;
+    int csec = csecs % 100;
+    if (min)
+        snprintf(out, len, "%d:%02d.%02d", min, sec, csec);
+    else
+        snprintf(out, len, "%d.%02d", sec, csec);
+}
+
+void draw_stats(Panel *panel, uint64_t time, int pieces, int keys, int holds, HistoryStats *hist) {
+    // Only the shown centiseconds matter for redraws
+    int csecs = time / (NS_PER_MS * 10);
+    struct {
+        int csecs, pieces, keys, holds;
+        HistoryStats hist;
+    } key;
+    memset(&key, 0, sizeof(key));
+    key.csecs = csecs;
+    key.pieces = pieces;
+    key.keys = keys;
+    key.holds = holds;
+    if (hist)
+        key.hist = *hist;
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, &key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+
+    char buf[16];
+    format_csecs(buf, sizeof(buf), csecs);
+    panel_printf(panel, 0, 0, 0, 0, "%6s %s", "Time", buf);
+    panel_printf(panel, 1, 0, 0, 0, "%6s %.2f", "PPS", pieces ? pieces / ((double) time / NS_PER_SEC) : 0);
+    panel_printf(panel, 2, 0, 0, 0, "%6s %.2f", "KPP", pieces ? (float) keys / pieces : 0);
+    panel_printf(panel, 3, 0, 0, 0, "%6s %d", "Hold", holds);
+    panel_printf(panel, 4, 0, 0, 0, "%6s %d", "#", pieces);
+
+    if (hist && hist->runs) {
+        format_csecs(buf, sizeof(buf), hist->best_us / 10000);
+        panel_printf(panel, 0, 14, 0, 0, "%5s %s", "PB", buf);
+        if (hist->split >= 0) {
+            // Green ahead of the best run, red behind
+            int delta = hist->delta_us / 10000;
+            int abs = delta < 0 ? -delta : delta;
+            format_csecs(buf, sizeof(buf), abs);
+            panel_printf(panel, 1, 14, 0, 0, "%5d", (hist->split + 1) * SPLIT_LINES);
+            panel_printf(panel, 1, 20, delta <= 0 ? 5 : 7, 0, "%c%s", delta <= 0 ? '-' : '+', buf);
+            panel_printf(panel, 2, 14, 0, 0, "%5s %d%%", "Beats", hist->beats);
+        }
+        panel_printf(panel, 3, 14, 0, 0, "%5s %u", "Runs", hist->runs);
+    }
+    panel_done(panel);
+}
+
+void draw_finesse(Panel *panel, int faults, int8_t fault, int8_t keys, Finesse *best) {
+    struct {
+        int faults;
+        int8_t keys;
+        int8_t len;
+        int8_t seq[SEARCH_MAX_PATH + 1];
+    } key;
+    memset(&key, 0, sizeof(key));
+    key.faults = faults;
+    if (fault) {
+        key.keys = keys;
+        key.len = best->len;
+        memcpy(key.seq, best->keys, best->len);
+    }
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, &key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+    panel_printf(panel, 0, 0, 0, 0, "%6s %d", "Faults", faults);
+    if (fault) {
+        int x = panel_printf(panel, 1, 0, 7, 0, "%6s %d keys, best", "Fault", keys);
+        for (int8_t i = 0; i < best->len; i++)
+            x = panel_printf(panel, 1, x, 7, 0, " %s", key_chars[best->keys[i]]);
+    }
+    panel_done(panel);
+}
+
+void draw_pc(Panel *panel, PcResult *res) {
+    struct {
+        uint32_t id;
+        int8_t status;
+    } key;
+    memset(&key, 0, sizeof(key));
+    key.id = res->id;
+    key.status = res->status;
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, &key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+    switch (res->status) {
+    case PC_IDLE:
+        break;
+    case PC_SOLVING:
+        panel_puts(panel, 0, 0, 0, 0, "PC solving...");
+        break;
+    case PC_NONE:
+        panel_puts(panel, 0, 0, 0, 0, "PC none in sight");
+        break;
+    case PC_GAVE_UP:
+        panel_puts(panel, 0, 0, 0, 0, "PC unknown, search gave up");
+        break;
+    case PC_FOUND: {
+        // Steps that start by pressing hold are marked after the count
+        int x = panel_printf(panel, 0, 0, 0, 0, "PC in %d", res->n);
+        for (int8_t i = 0; i < res->n; i++)
+            if (res->held[i])
+                x = panel_printf(panel, 0, x, 0, 0, " ↕%d", i + 1);
+        for (int8_t y = 0; y < res->height; y++) {
+            for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+                int8_t step = res->grid[y][x];
+                int8_t row = 1 + res->height - 1 - y;
+                if (step < 0)
+                    panel_puts(panel, row, 2 * x, 8, 0, "▓▓");
+                else if (step)
+                    panel_printf(panel, row, 2 * x, res->type[step - 1] + 1, A_REVERSE, "%d ", step);
+            }
+        }
+        break;
+    }
+    }
+    panel_done(panel);
+}
+
+void draw_perf(Panel *panel, Perf *perf) {
+    Hist *hists[3] = { &perf->latency, &perf->draw, &perf->frame };
+    static const char *names[3] = { "Input", "Draw", "Frame" };
+
+    // Shown to 10us, finer changes would redraw every frame
+    struct {
+        uint16_t t[3][3];
+        uint32_t missed;
+    } key;
+    memset(&key, 0, sizeof(key));
+    for (int8_t i = 0; i < 3; i++) {
+        uint64_t t[3] = {
+            hist_percentile(hists[i], 0.5),
+            hist_percentile(hists[i], 0.99),
+            hists[i]->max
+        };
+        for (int8_t j = 0; j < 3; j++)
+            key.t[i][j] = t[j] / 10000 < UINT16_MAX ? t[j] / 10000 : UINT16_MAX;
+    }
+    key.missed = perf->missed;
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, &key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+    panel_printf(panel, 0, 0, 0, 0, "%6s %7s %7s %7s", "ms", "p50", "p99", "max");
+    for (int8_t i = 0; i < 3; i++)
+        panel_printf(panel, 1 + i, 0, 0, 0, "%6s %7.2f %7.2f %7.2f", names[i],
+            key.t[i][0] / 100.0, key.t[i][1] / 100.0, key.t[i][2] / 100.0);
+    panel_printf(panel, 4, 0, 0, 0, "%6s %llu", "Missed", (unsigned long long) perf->missed);
+    panel_done(panel);
+}
+
+void draw_garbage(Panel *panel, int pending) {
+    PANEL_KEY_FITS(pending);
+    if (!panel_changed(panel, &pending, sizeof(pending)))
+        return;
+
+    panel_erase(panel);
+    for (int i = 0; i < pending && i < panel->h; i++)
+        panel_puts(panel, panel->h - 1 - i, 0, 7, 0, "█");
+    panel_done(panel);
+}
+
+void draw_peer(Panel *panel, Peer *peer) {
+    struct {
+        uint32_t version;
+        int pieces, sent, pending;
+        int8_t connected, lost;
+    } key = { peer->version, peer->pieces, peer->sent, peer->pending, peer->connected, peer->lost };
+    PANEL_KEY_FITS(key);
+    if (!panel_changed(panel, &key, sizeof(key)))
+        return;
+
+    panel_erase(panel);
+    for (int8_t i = 0; i < BOARD_HEIGHT; i++) {
+        if (BOARD_HEIGHT - i <= peer->pending)
+            panel_puts(panel, i, 0, 7, 0, "█");
+        panel_puts(panel, i, 1, 0, 0, "█");
+        panel_puts(panel, i, 2 + BOARD_WIDTH * 2, 0, 0, "█");
+    }
+    for (int8_t i = 0; i < BOARD_WIDTH + 1; i++)
+        panel_puts(panel, BOARD_HEIGHT, 1 + i * 2, 0, 0, "▀▀");
+
+    if (peer->connected) {
+        for (int8_t i = 0; i < BOARD_HEIGHT; i++)
+            for (int8_t j = 0; j < BOARD_WIDTH; j++)
+                if (peer->colors[i][j])
+                    panel_puts(panel, BOARD_HEIGHT - 1 - i, 2 + 2 * j, peer->colors[i][j], 0, "██");
+        if (peer->lost)
+            panel_puts(panel, BOARD_HEIGHT + 1, 2, 0, 0, "Topped out");
+        else
+            panel_printf(panel, BOARD_HEIGHT + 1, 2, 0, 0, "# %d  Sent %d", peer->pieces, peer->sent);
+    } else {
+        panel_puts(panel, BOARD_HEIGHT + 1, 2, 0, 0, "Waiting for player");
+    }
+    panel_done(panel);
+}
@@ -0,0 +1,110 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include "evdev.h"
+#include "timing.h"
+
+// Open keyboards, all watched through one epoll descriptor
+static int evdev_fds[EVDEV_MAX];
+static int evdev_n;
+
+#define BIT_SET(bits, n) ((bits)[(n) / 8] & (1 << (n) % 8))
+
+// Anything with letter keys and a space bar counts as a keyboard
+static int is_keyboard(int fd) {
+    uint8_t keys[KEY_MAX / 8 + 1] = { 0 };
+    if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0)
+        return 0;
+    return BIT_SET(keys, KEY_A) && BIT_SET(keys, KEY_Z) && BIT_SET(keys, KEY_SPACE);
+}
+
+int evdev_open() {
+    DIR *dir = opendir(EVDEV_DIR);
+    if (!dir)
+        return -1;
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        closedir(dir);
+        return -1;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) && evdev_n < EVDEV_MAX) {
+        if (strncmp(ent->d_name, "event", 5))
+            continue;
+        char path[300];
+        snprintf(path, sizeof(path), EVDEV_DIR "/%s", ent->d_name);
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        // Event times on the same clock as get_ns
+        int clock = CLOCK_MONOTONIC;
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+        if (!is_keyboard(fd)
+          || ioctl(fd, EVIOCSCLOCKID, &clock)
+          || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+            close(fd);
+            continue;
+        }
+        evdev_fds[evdev_n++] = fd;
+    }
+    closedir(dir);
+
+    if (!evdev_n) {
+        close(epfd);
+        return -1;
+    }
+    return epfd;
+}
+
+void evdev_close(int epfd) {
+    for (int i = 0; i < evdev_n; i++)
+        close(evdev_fds[i]);
+    evdev_n = 0;
+    close(epfd);
+}
+
+int evdev_read(int epfd, EvdevKey *out, int max) {
+    struct epoll_event ready[EVDEV_MAX];
+    int nready = epoll_wait(epfd, ready, EVDEV_MAX, 0);
+
+    int n = 0;
+    for (int i = 0; i < nready && n < max; i++) {
+        // Never read more than fits, the rest is still there next frame
+        struct input_event buf[64];
+        ssize_t len;
+        size_t want = max - n < 64 ? max - n : 64;
+        while (n < max && (len = read(ready[i].data.fd, buf, want * sizeof(buf[0]))) > 0) {
+            for (size_t j = 0; j < len / sizeof(buf[0]) && n < max; j++) {
+                struct input_event *e = &buf[j];
+                if (e->type != EV_KEY)
+                    continue;
+                out[n].time = (uint64_t) e->input_event_sec * NS_PER_SEC
+                            + (uint64_t) e->input_event_usec * 1000;
+                out[n].code = e->code;
+                // 2 is autorepeat, the key is still down
+                out[n].pressed = e->value != 0;
+                n++;
+            }
+            want = max - n < 64 ? max - n : 64;
+        }
+    }
+
+    // Each keyboard's keys come in order but one after another, so they are
+    // merged by time for the core, keeping presses at the same time in order
+    for (int i = 1; i < n; i++) {
+        EvdevKey k = out[i];
+        int j = i;
+        for (; j > 0 && out[j - 1].time > k.time; j--)
+            out[j] = out[j - 1];
+        out[j] = k;
+    }
+    return n;
+}
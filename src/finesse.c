@@ -0,0 +1,63 @@
+#include <string.h>
+#include "finesse.h"
+
+static int8_t finesse_done(Finesse *out, const int8_t *keys, int8_t len) {
+    memcpy(out->keys, keys, len);
+    out->keys[len] = HD;
+    out->len = len + 1;
+    return out->len;
+}
+
+// Only the tops of the stack can stop a piece moving at spawn height, so on a
+// low enough stack the memoised empty board moves apply as they are
+static int8_t check_moves(Board *board, uint64_t target, int8_t type, Finesse *out) {
+    for (int8_t y = finesse_clear_row[type]; y < ARR_HEIGHT; y++)
+        if (board->rows[y])
+            return -1;
+
+    const FinesseMove *best = NULL;
+    for (int8_t rot = 0; rot < 4; rot++) {
+        for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+            const FinesseMove *m = &finesse_moves[type][rot][x];
+            if (m->len < 0 || (best && m->len >= best->len))
+                continue;
+            Piece p = { .x = x, .y = m->y, .type = type, .rot = rot };
+            move_piece(board, &p, 0, -p.y);
+            if (search_cells(&p) == target)
+                best = m;
+        }
+    }
+    return best ? finesse_done(out, best->keys, best->len) : -1;
+}
+
+static int8_t check_search(Board *board, uint64_t target, int8_t type, int8_t soft_drop, Finesse *out) {
+    Search s;
+    Piece start;
+    gen_piece(&start, type);
+    search_run(&s, board, &start, soft_drop);
+
+    for (int i = 0; i < s.n; i++) {
+        Piece p;
+        search_piece(&s, s.order[i], &p);
+        move_piece(board, &p, 0, -p.y);
+        if (search_cells(&p) != target)
+            continue;
+        int8_t keys[SEARCH_MAX_PATH];
+        int8_t len = search_path(&s, s.order[i], keys);
+        if (len >= 0)
+            return finesse_done(out, keys, len);
+    }
+    return -1;
+}
+
+int8_t finesse_check(Board *board, Piece *p, Finesse *out) {
+    uint64_t target = search_cells(p);
+    int8_t len = check_moves(board, target, p->type, out);
+    if (len < 0)
+        len = check_search(board, target, p->type, 0, out);
+    if (len < 0)
+        len = check_search(board, target, p->type, 1, out);
+    if (len < 0)
+        out->len = 0;
+    return len;
+}
@@ -0,0 +1,86 @@
+#include "handling.h"
+#include "board.h"
+#include "timing.h"
+
+void handling_init(Handling *h, Config *config, uint64_t grav) {
+    h->das = config->das * NS_PER_MS;
+    h->arr = config->arr * NS_PER_MS;
+    h->sdf = config->sdf;
+    handling_gravity(h, grav);
+
+    h->held[0] = h->held[1] = 0;
+    h->dir = 0;
+    h->charge_start = 0;
+    h->shifted = 0;
+    h->sd_held = 0;
+    h->sd_start = 0;
+    h->dropped = 0;
+}
+
+void handling_gravity(Handling *h, uint64_t grav) {
+    h->sd_interval = h->sdf ? grav / h->sdf : 0;
+}
+
+int8_t handling_shift_key(Handling *h, int8_t dir, int8_t pressed, uint64_t time) {
+    // Catch up on the old direction before it changes
+    int8_t moved = handling_shift(h, time);
+    int8_t i = dir > 0;
+
+    h->held[i] = pressed;
+    if (pressed) {
+        h->dir = dir;
+        h->charge_start = time;
+        h->shifted = 0;
+        return moved + dir;
+    }
+
+    // Releasing the active direction hands over to the other one if it is
+    // still held, which charges DAS again from here
+    if (h->dir == dir) {
+        h->dir = h->held[!i] ? -dir : 0;
+        h->charge_start = time;
+        h->shifted = 0;
+    }
+    return moved;
+}
+
+void handling_sd_key(Handling *h, int8_t pressed, uint64_t time) {
+    h->sd_held = pressed;
+    h->sd_start = time;
+    h->dropped = 0;
+}
+
+int8_t handling_shift(Handling *h, uint64_t now) {
+    if (!h->dir || now < h->charge_start + h->das)
+        return 0;
+    if (!h->arr)
+        return h->dir * BOARD_WIDTH;
+
+    uint32_t due = (now - h->charge_start - h->das) / h->arr + 1;
+    int32_t moves = due - h->shifted;
+    h->shifted = due;
+    if (moves > BOARD_WIDTH)
+        moves = BOARD_WIDTH;
+    return h->dir * moves;
+}
+
+int8_t handling_drop(Handling *h, uint64_t now) {
+    if (!h->sd_held)
+        return 0;
+    if (!h->sd_interval)
+        return ARR_HEIGHT;
+
+    uint32_t due = (now - h->sd_start) / h->sd_interval + 1;
+    int32_t drops = due - h->dropped;
+    h->dropped = due;
+    if (drops > ARR_HEIGHT)
+        drops = ARR_HEIGHT;
+    return drops;
+}
+
+void handling_new_piece(Handling *h, uint64_t time) {
+    if (h->sd_held) {
+        h->sd_start = time;
+        h->dropped = 0;
+    }
+}
@@ -0,0 +1,199 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "history.h"
+
+static int bucket(uint32_t us) {
+    uint32_t b = us / HISTORY_BUCKET_US;
+    return b < HISTORY_BUCKETS ? b : HISTORY_BUCKETS - 1;
+}
+
+static void index_reset(HistoryIndex *x) {
+    memset(x, 0, sizeof(*x));
+    memcpy(x->magic, HISTORY_INDEX_MAGIC, 4);
+    x->version = HISTORY_VERSION;
+    x->size = sizeof(HistoryRun);
+}
+
+static void index_add(HistoryIndex *x, const HistoryRun *r) {
+    x->dirty = 1;
+    for (int k = 0; k < SPLITS; k++) {
+        uint32_t t = r->splits_us[k];
+        if (!x->runs || t < x->gold_us[k])
+            x->gold_us[k] = t;
+        for (int b = bucket(t); b < HISTORY_BUCKETS; b++)
+            x->upto[k][b]++;
+    }
+    if (!x->runs || r->time_us < x->best.time_us) {
+        x->best = *r;
+        x->best_n = x->runs;
+    }
+    x->runs++;
+    x->dirty = 0;
+}
+
+int history_dir(char *path, size_t len) {
+    char *data_env = getenv("XDG_DATA_HOME");
+    char *home_env = getenv("HOME");
+    int n;
+    if (data_env)
+        n = snprintf(path, len, "%s/tetty", data_env);
+    else if (home_env)
+        n = snprintf(path, len, "%s/.local/share/tetty", home_env);
+    else
+        return -1;
+    if (n < 0 || (size_t) n >= len)
+        return -1;
+
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = 0;
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    if (mkdir(path, 0755) && errno != EEXIST)
+        return -1;
+    return 0;
+}
+
+// Returns the number of whole runs in the history file, writing the header
+// to a new one and dropping a run cut short by a crash
+static long history_check(int fd) {
+    struct stat st;
+    if (fstat(fd, &st))
+        return -1;
+
+    HistoryHeader header;
+    if (!st.st_size) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, HISTORY_MAGIC, 4);
+        header.version = HISTORY_VERSION;
+        header.size = sizeof(HistoryRun);
+        return write(fd, &header, sizeof(header)) == sizeof(header) ? 0 : -1;
+    }
+
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      || memcmp(header.magic, HISTORY_MAGIC, 4)
+      || header.version != HISTORY_VERSION
+      || header.size != sizeof(HistoryRun))
+        return -1;
+
+    off_t body = st.st_size - sizeof(header);
+    if (body % sizeof(HistoryRun) && ftruncate(fd, st.st_size - body % sizeof(HistoryRun)))
+        return -1;
+    return body / sizeof(HistoryRun);
+}
+
+// Counts the runs from the index's last one up to runs, reading them
+// straight out of the mapped file
+static int index_catch_up(HistoryIndex *x, int fd, long runs) {
+    size_t len = sizeof(HistoryHeader) + runs * sizeof(HistoryRun);
+    uint8_t *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    HistoryRun *run = (HistoryRun *) (map + sizeof(HistoryHeader));
+    for (long i = x->runs; i < runs; i++)
+        index_add(x, &run[i]);
+    munmap(map, len);
+    return 0;
+}
+
+int history_open(History *h, const char *dir) {
+    h->fd = -1;
+    h->index = NULL;
+
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/history", dir) >= (int) sizeof(path))
+        return -1;
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        return -1;
+    long runs = history_check(fd);
+    if (runs < 0) {
+        close(fd);
+        return -1;
+    }
+
+    strcat(path, ".idx");
+    int idx_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (idx_fd < 0 || ftruncate(idx_fd, sizeof(HistoryIndex))) {
+        if (idx_fd >= 0)
+            close(idx_fd);
+        close(fd);
+        return -1;
+    }
+    HistoryIndex *x = mmap(NULL, sizeof(HistoryIndex), PROT_READ | PROT_WRITE, MAP_SHARED, idx_fd, 0);
+    close(idx_fd);
+    if (x == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    // Anything that doesn't match the history is counted again from scratch
+    if (memcmp(x->magic, HISTORY_INDEX_MAGIC, 4) || x->version != HISTORY_VERSION
+      || x->size != sizeof(HistoryRun) || x->dirty || x->runs > (uint64_t) runs)
+        index_reset(x);
+    if (x->runs < (uint64_t) runs && index_catch_up(x, fd, runs)) {
+        munmap(x, sizeof(HistoryIndex));
+        close(fd);
+        return -1;
+    }
+
+    h->fd = fd;
+    h->index = x;
+    return 0;
+}
+
+void history_close(History *h) {
+    if (h->index)
+        munmap(h->index, sizeof(HistoryIndex));
+    if (h->fd >= 0)
+        close(h->fd);
+    h->index = NULL;
+    h->fd = -1;
+}
+
+int history_add(History *h, GameState *s, uint32_t seed) {
+    if (!s->done || s->n_splits < SPLITS)
+        return -1;
+    HistoryRun r = {
+        .date = time(NULL),
+        .seed = seed,
+        .time_us = s->end_time / CORE_RES,
+        .pieces = s->pieces,
+        .keys = s->keys,
+        .holds = s->holds,
+        .faults = s->faults,
+    };
+    for (int k = 0; k < SPLITS; k++)
+        r.splits_us[k] = s->splits[k] / CORE_RES;
+
+    // A run only counts once it is safely in the file
+    if (write(h->fd, &r, sizeof(r)) != sizeof(r))
+        return -1;
+    index_add(h->index, &r);
+    return 0;
+}
+
+void history_stats(History *h, GameState *s, HistoryStats *out) {
+    memset(out, 0, sizeof(*out));
+    HistoryIndex *x = h->index;
+    out->runs = x->runs;
+    out->split = s->n_splits - 1;
+    if (!x->runs)
+        return;
+    out->best_us = x->best.time_us;
+    if (out->split < 0)
+        return;
+
+    uint32_t t = s->splits[out->split] / CORE_RES;
+    out->delta_us = (int32_t) (t - x->best.splits_us[out->split]);
+    out->beats = (x->runs - x->upto[out->split][bucket(t)]) * 100 / x->runs;
+}
@@ -1,18 +1,191 @@
 #include <curses.h>
 #include <fcntl.h>
 #include <linux/kd.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include "evdev.h"
 #include "input.h"
+#include "termcache.h"
+#include "timing.h"
 
-enum Parser {
-    CODE,
-    MOD,
-    STATE,
-    END,
-    INVALID,
+// Byte classes and states of the CSI u decoder
+enum KeyClass {
+    C_OTHER,
+    C_ESC,
+    C_BRACKET,
+    C_DIGIT,
+    C_SEMI,
+    C_COLON,
+    C_FINAL,
+    C_QUERY,
+    CLASSES
 };
 
+enum KeyState {
+    S_GROUND,
+    S_ESC,
+    S_CSI,
+    STATES
+};
+
+enum KeyAction {
+    A_NONE,
+    A_START,
+    A_DIGIT,
+    A_FIELD,
+    A_SUB,
+    A_QUERY,
+    A_EMIT
+};
+
+typedef struct KeyStep {
+    uint8_t next;
+    uint8_t action;
+} KeyStep;
+
+// Anything unexpected drops the sequence, an ESC always starts a new one
+static const KeyStep key_steps[STATES][CLASSES] = {
+    [S_GROUND] = {
+        [C_OTHER]   = { S_GROUND, A_NONE },
+        [C_ESC]     = { S_ESC,    A_NONE },
+        [C_BRACKET] = { S_GROUND, A_NONE },
+        [C_DIGIT]   = { S_GROUND, A_NONE },
+        [C_SEMI]    = { S_GROUND, A_NONE },
+        [C_COLON]   = { S_GROUND, A_NONE },
+        [C_FINAL]   = { S_GROUND, A_NONE },
+        [C_QUERY]   = { S_GROUND, A_NONE },
+    },
+    [S_ESC] = {
+        [C_OTHER]   = { S_GROUND, A_NONE },
+        [C_ESC]     = { S_ESC,    A_NONE },
+        [C_BRACKET] = { S_CSI,    A_START },
+        [C_DIGIT]   = { S_GROUND, A_NONE },
+        [C_SEMI]    = { S_GROUND, A_NONE },
+        [C_COLON]   = { S_GROUND, A_NONE },
+        [C_FINAL]   = { S_GROUND, A_NONE },
+        [C_QUERY]   = { S_GROUND, A_NONE },
+    },
+    [S_CSI] = {
+        [C_OTHER]   = { S_GROUND, A_NONE },
+        [C_ESC]     = { S_ESC,    A_NONE },
+        [C_BRACKET] = { S_GROUND, A_NONE },
+        [C_DIGIT]   = { S_CSI,    A_DIGIT },
+        [C_SEMI]    = { S_CSI,    A_FIELD },
+        [C_COLON]   = { S_CSI,    A_SUB },
+        [C_FINAL]   = { S_GROUND, A_EMIT },
+        [C_QUERY]   = { S_CSI,    A_QUERY },
+    },
+};
+
+static uint8_t key_classes[256];
+
+static void key_classes_init() {
+    if (key_classes[0x1b])
+        return;
+    for (int c = '0'; c <= '9'; c++)
+        key_classes[c] = C_DIGIT;
+    for (const char *f = "uABCDEFHPQRS~"; *f; f++)
+        key_classes[(uint8_t) *f] = C_FINAL;
+    key_classes[';'] = C_SEMI;
+    key_classes[':'] = C_COLON;
+    key_classes['['] = C_BRACKET;
+    key_classes['?'] = C_QUERY;
+    key_classes[0x1b] = C_ESC;
+}
+
+// Legacy CSI number ~ keys that kitty still sends that way
+static uint32_t tilde_key(uint32_t n) {
+    switch (n) {
+    case 2:  return KEY_IC;
+    case 3:  return KEY_DC;
+    case 5:  return KEY_PPAGE;
+    case 6:  return KEY_NPAGE;
+    case 7:  return KEY_HOME;
+    case 8:  return KEY_END;
+    case 11: case 12: case 13: case 14: case 15:
+        return KEY_F(n - 10);
+    case 17: case 18: case 19: case 20: case 21:
+        return KEY_F(n - 11);
+    case 23: case 24:
+        return KEY_F(n - 12);
+    }
+    return 0;
+}
+
+static uint32_t final_key(char final, uint32_t n) {
+    switch (final) {
+    case 'u': return n;
+    case '~': return tilde_key(n);
+    case 'A': return KEY_UP;
+    case 'B': return KEY_DOWN;
+    case 'C': return KEY_RIGHT;
+    case 'D': return KEY_LEFT;
+    case 'E': return KEY_B2;
+    case 'F': return KEY_END;
+    case 'H': return KEY_HOME;
+    case 'P': return KEY_F(1);
+    case 'Q': return KEY_F(2);
+    case 'R': return KEY_F(3);
+    case 'S': return KEY_F(4);
+    }
+    return 0;
+}
+
+int key_decode(KeyDecoder *d, const char *buf, size_t n, KeyEvent *out, int max) {
+    key_classes_init();
+    int count = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = buf[i];
+        KeyStep step = key_steps[d->state][key_classes[c]];
+        d->state = step.next;
+
+        switch (step.action) {
+        case A_NONE:
+            break;
+        case A_START:
+            memset(d->params, 0, sizeof(d->params));
+            d->field = 0;
+            d->sub = 0;
+            d->query = 0;
+            break;
+        case A_DIGIT:
+            // Fields and subfields past the ones used are skipped
+            if (d->field < 3 && d->sub < 2 && d->params[d->field][d->sub] < 1000000)
+                d->params[d->field][d->sub] = d->params[d->field][d->sub] * 10 + c - '0';
+            break;
+        case A_FIELD:
+            d->field++;
+            d->sub = 0;
+            break;
+        case A_SUB:
+            d->sub++;
+            break;
+        case A_QUERY:
+            d->query = 1;
+            break;
+        case A_EMIT: {
+            // CSI ? flags u answers the query for the enhancement flags
+            if (d->query) {
+                if (c == 'u' && count < max)
+                    out[count++] = (KeyEvent) { d->params[0][0], 0, KEY_FLAGS };
+                break;
+            }
+            // CSI key ; modifiers : type u, missing fields default to 1
+            uint32_t key = final_key(c, d->params[0][0] ? d->params[0][0] : 1);
+            uint32_t mods = d->params[1][0] ? d->params[1][0] - 1 : 0;
+            uint32_t type = d->params[1][1] ? d->params[1][1] : KEY_PRESS;
+            if (key && type <= KEY_RELEASE && count < max)
+                out[count++] = (KeyEvent) { key, mods, type };
+            break;
+        }
+        }
+    }
+    return count;
+}
+
 static const char *conspath[] = {
     "/proc/self/fd/0",
     "/dev/tty",
@@ -23,19 +196,38 @@ static const char *conspath[] = {
     NULL
 };
 
+// Kitty flags pushed at startup, and how long the terminal gets to confirm
+// them
+#define KITTY_FLAGS 11
+#define PROBE_NS (100 * NS_PER_MS)
+
+static InputProbe probe;
+// Where a late switch to scancodes keeps the console's old settings
+static struct termios *probe_old;
+static struct termios *probe_new;
+// Console scancodes are read from
+static char console[64];
+
 int is_a_console(int fd) {
     char arg = 0;
     return (isatty(fd) && ioctl(fd, KDGKBTYPE, &arg) == 0 && ((arg == KB_101) || (arg == KB_84)));
 }
 
-int getfd(struct termios* old, struct termios* new) {
-    int fd = 0;
+// Tries only path if it is set, otherwise every known console path
+int getfd(struct termios* old, struct termios* new, const char *path) {
+    const char *only[] = { path, NULL };
+    const char **paths = path ? only : conspath;
+    int fd = -1;
 
-    for (int i = 0; conspath[i]; i++) {
-        fd = open(conspath[i], O_RDONLY | O_NOCTTY | O_NONBLOCK);
-        if (is_a_console(fd))
+    for (int i = 0; paths[i]; i++) {
+        fd = open(paths[i], O_RDONLY | O_NOCTTY | O_NONBLOCK);
+        if (is_a_console(fd)) {
+            snprintf(console, sizeof(console), "%s", paths[i]);
             break;
-        close(fd);
+        }
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
     }
 
     if (fd < 0) {
@@ -66,17 +258,62 @@ int getfd(struct termios* old, struct termios* new) {
     return fd;
 }
 
+static void kitty_query() {
+    fprintf(stderr, "\e[>%du", KITTY_FLAGS);
+    fprintf(stderr, "\e[?u");
+}
+
+// A terminal seen before gets the mode it had last time without waiting on
+// it. Scancodes are checked on the spot by opening the same console, the
+// kitty query is sent but answered while the game runs
+static int mode_from_cache(enum InputMode *mode, struct termios *old, struct termios *new, int *fd) {
+    enum InputMode cached;
+    char path[sizeof(console)];
+    if (termcache_get(&cached, path, sizeof(path)))
+        return -1;
+
+    if (cached == SCANCODES) {
+        if (!*path || (*fd = getfd(old, new, path)) < 0)
+            return -1;
+    } else if (cached == EXTKEYS || cached == NORM) {
+        kitty_query();
+        probe.pending = 1;
+    } else {
+        return -1;
+    }
+    probe.cached = 1;
+    *mode = cached;
+    return 0;
+}
 
 enum InputMode mode_set(enum InputMode mode, struct termios* old, struct termios* new, int *fd) {
+    memset(&probe, 0, sizeof(probe));
+    probe_old = old;
+    probe_new = new;
+    probe.start = get_ns();
+
+    // Setup evdev, the terminal's own protocol is the fallback
+    if (mode == EVDEV) {
+        *fd = evdev_open();
+        if (*fd < 0)
+            mode = EXTKEYS;
+    }
+
+    if (mode == EXTKEYS && !mode_from_cache(&mode, old, new, fd)) {
+        probe.mode = mode;
+        probe.end = get_ns();
+        return mode;
+    }
+
     // Setup extkeys
     if (mode == EXTKEYS) {
-        fprintf(stderr, "\e[>11u");
-        fprintf(stderr, "\e[?u");
-        char *response = "\e[?11u";
+        kitty_query();
+        char response[8];
+        snprintf(response, sizeof(response), "\e[?%du", KITTY_FLAGS);
 
         nodelay(stdscr, 0);
         timeout(100);
-        char c = getch();
+        int c = getch();
         nodelay(stdscr, 1);
 
         for (int8_t i = 0; i < 6; i++) {
@@ -89,31 +326,85 @@ enum InputMode mode_set(enum InputMode mode, struct termios* old, struct termios
 
     // Setup fd to read from console
     if (mode == SCANCODES) {
-        *fd = getfd(old, new);
+        *fd = getfd(old, new, NULL);
         if (*fd < 0) {
             mode = NORM;
         }
     }
+
+    if (mode != EVDEV)
+        termcache_put(mode, mode == SCANCODES ? console : NULL);
+    probe.mode = mode;
+    probe.end = get_ns();
     return mode;
 }
 
-void update_input(Config *config, int8_t inputs[KEYS], uint32_t key, int8_t pressed) {
-    if (key == config->left)  { inputs[0] = pressed; return; }
-    if (key == config->right) { inputs[1] = pressed; return; }
-    if (key == config->sd)    { inputs[2] = pressed; return; }
-    if (key == config->hd)    { inputs[3] = pressed; return; }
-    if (key == config->ccw)   { inputs[4] = pressed; return; }
-    if (key == config->cw)    { inputs[5] = pressed; return; }
-    if (key == config->flip)  { inputs[6] = pressed; return; }
-    if (key == config->hold)  { inputs[7] = pressed; return; }
-    if (key == config->reset) { inputs[8] = pressed; return; }
-    if (key == config->quit)  { inputs[9] = pressed; return; }
+int input_verify(Config *config, int *fd) {
+    if (!probe.pending)
+        return 0;
+    uint64_t now = get_ns();
+    if (!probe.answered && now - probe.end < PROBE_NS)
+        return 0;
+    probe.pending = 0;
+    probe.verified = now;
+
+    int8_t kitty = probe.answered && probe.flags == KITTY_FLAGS;
+    enum InputMode mode = config->mode;
+    if (mode == EXTKEYS && !kitty) {
+        // Not a kitty terminal any more, the rest of the probe as it would
+        // have gone at startup
+        fprintf(stderr, "\e[<u");
+        *fd = getfd(probe_old, probe_new, NULL);
+        mode = *fd >= 0 ? SCANCODES : NORM;
+    } else if (mode == NORM && kitty) {
+        mode = EXTKEYS;
+    }
+    if (mode == config->mode)
+        return 0;
+
+    termcache_put(mode, mode == SCANCODES ? console : NULL);
+    probe.changed = 1;
+    config->mode = mode;
+    return 1;
+}
+
+const InputProbe *input_probe() {
+    return &probe;
+}
+
+static void probe_answer(uint32_t flags) {
+    if (!probe.pending)
+        return;
+    probe.answered = 1;
+    probe.flags = flags;
+}
+
+// Emits an event for every action that differs between the two masks
+void set_actions(InputState *inputs, InputEvents *events, uint64_t time, uint16_t actions) {
+    uint16_t changed = actions ^ inputs->actions;
+    inputs->actions = actions;
+    for (; changed && events->n < MAX_EVENTS; changed &= changed - 1) {
+        int8_t i = __builtin_ctz(changed);
+        events->ev[events->n++] = (InputEvent) { time, i, (actions >> i) & 1 };
+    }
+}
+
+void update_input(Config *config, InputState *inputs, InputEvents *events, uint64_t time, uint32_t key, int8_t pressed) {
+    int slot = keymap_slot(&config->keymap, key);
+    if (!slot)
+        return;
+    // An action stays down while any of its keys is
+    uint64_t bit = 1ull << (slot - 1);
+    inputs->down = pressed ? inputs->down | bit : inputs->down & ~bit;
+    set_actions(inputs, events, time, keymap_actions(&config->keymap, inputs->down));
 }
 
 void input_clean(enum InputMode mode, struct termios *old, int fd) {
     // Cleanup extkeys
     if (mode == EXTKEYS)
         fprintf(stderr, "\e[<u");
+    else if (mode == EVDEV)
+        evdev_close(fd);
     else if (mode == SCANCODES) {
         if (ioctl(fd, KDSKBMODE, K_UNICODE)) {
             fprintf(stderr, "ioctl KDSKBMODE error\n");
@@ -129,92 +420,92 @@ void input_clean(enum InputMode mode, struct termios *old, int fd) {
     }
 }
 
-void get_extkeys_input(int8_t inputs[KEYS], Config *config) {
-    char c;
-    enum Parser state = INVALID;
-    uint32_t key = 0;
-    int8_t pressed = 0;
-    while ((c = getch()) != ERR) {
-        if (c == 27) {
-            key = 0;
-            pressed = 0;
-            state = CODE;
-            continue;
-        }
+void get_extkeys_input(InputState *inputs, InputEvents *events, Config *config) {
+    static KeyDecoder decoder;
+    char buf[1024];
+    // The shortest sequence, CSI A, is three bytes
+    KeyEvent keys[sizeof(buf) / 3];
 
-        switch (state) {
-        case CODE:
-            if ('0' <= c && c <= '9') {
-                key *= 10;
-                key += (c - '0');
-            } else if (c == ';')
-                state++;
-            else if (c != '[')
-                state = INVALID;
-            break;
-        case MOD:
-            if (c == ':') state++;
-            break;
-        case STATE:
-            pressed = (c == '1');
-            state++;
-            break;
-        case END:
-            if (key == 1 && 'A' <= c && c <= 'D') {
-                switch (c) {
-                case 'A':
-                    key = KEY_UP;
-                    break;
-                case 'B':
-                    key = KEY_DOWN;
-                    break;
-                case 'C':
-                    key = KEY_RIGHT;
-                    break;
-                case 'D':
-                    key = KEY_LEFT;
-                    break;
-                }
-            }
-            update_input(config, inputs, key, pressed);
-            state++;
-            break;
-        case INVALID:
-            break;
+    // One read takes everything the terminal has sent, a roll of keys can
+    // arrive together and each transition is kept in order
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    if (poll(&pfd, 1, 0) <= 0)
+        return;
+    ssize_t len = read(STDIN_FILENO, buf, sizeof(buf));
+    uint64_t time = get_ns();
+    if (len <= 0)
+        return;
+
+    int n = key_decode(&decoder, buf, len, keys, sizeof(keys) / sizeof(keys[0]));
+    for (int i = 0; i < n; i++) {
+        if (keys[i].type == KEY_FLAGS) {
+            probe_answer(keys[i].key);
+            continue;
         }
+        // A repeat is a key still held down
+        update_input(config, inputs, events, time, keys[i].key, keys[i].type != KEY_RELEASE);
     }
 }
 
-void get_scan_input(int fd, int8_t inputs[KEYS], Config *config) {
+void get_scan_input(int fd, InputState *inputs, InputEvents *events, Config *config) {
     unsigned char buf[32];
     ssize_t n = read(fd, buf, sizeof(buf));
+    uint64_t time = get_ns();
 
     for (ssize_t i = 0; i < n; i++) {
-        update_input(config, inputs, buf[i], 1);
-        update_input(config, inputs, buf[i] ^ 0x80, 0);
+        update_input(config, inputs, events, time, buf[i], 1);
+        update_input(config, inputs, events, time, buf[i] ^ 0x80, 0);
     }
 }
 
-void get_norm_input(int8_t inputs[KEYS], Config *config) {
+void get_evdev_input(int fd, InputState *inputs, InputEvents *events, Config *config) {
+    EvdevKey keys[MAX_EVENTS];
+    int n = evdev_read(fd, keys, MAX_EVENTS);
+    for (int i = 0; i < n; i++)
+        update_input(config, inputs, events, keys[i].time, keys[i].code, keys[i].pressed);
+
+    // The terminal sees the same keys, drop them so they don't pile up
+    flushinp();
+}
+
+void get_norm_input(InputState *inputs, InputEvents *events, Config *config) {
     int c;
-    for (int i = 0; i < KEYS; i++) {
-        inputs[i] = 0;
-    }
+    uint64_t time = get_ns();
+    // No releases in this mode, keys count as held until the next read
+    inputs->down = 0;
+    set_actions(inputs, events, time, 0);
+    // A repeated key is a fresh press, not a key still being held
     while ((c = getch()) != ERR) {
-        update_input(config, inputs, (uint32_t) c, 1);
+        // Only watched for a reply to the kitty query, which comes as keys
+        if (probe.pending && c < 256) {
+            char byte = c;
+            KeyEvent reply;
+            if (key_decode(&probe.decoder, &byte, 1, &reply, 1) && reply.type == KEY_FLAGS)
+                probe_answer(reply.key);
+        }
+        update_input(config, inputs, events, time, (uint32_t) c, 0);
+        update_input(config, inputs, events, time, (uint32_t) c, 1);
     }
 }
 
-void get_inputs(Config *config, int fd, int8_t inputs[KEYS]) {
+void get_inputs(Config *config, int fd, InputState *inputs, InputEvents *events) {
+    events->n = 0;
     switch (config->mode) {
     case EXTKEYS:
-        get_extkeys_input(inputs, config);
+        get_extkeys_input(inputs, events, config);
         break;
     case SCANCODES:
-        get_scan_input(fd, inputs, config);
+        get_scan_input(fd, inputs, events, config);
         break;
     case NORM:
-        get_norm_input(inputs, config);
+        get_norm_input(inputs, events, config);
+        break;
+    case EVDEV:
+        get_evdev_input(fd, inputs, events, config);
         break;
     }
 }
+
+int input_fd(Config *config, int fd) {
+    return config->mode == SCANCODES || config->mode == EVDEV ? fd : STDIN_FILENO;
+}
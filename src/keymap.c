@@ -0,0 +1,52 @@
+#include <string.h>
+#include "keymap.h"
+
+static uint32_t hash(uint32_t key) {
+    return (key * 0x9e3779b1u >> 16) % KEYMAP_HASH;
+}
+
+void keymap_clear(Keymap *map) {
+    memset(map, 0, sizeof(*map));
+}
+
+int keymap_bind(Keymap *map, uint32_t key, uint8_t action) {
+    if (!key)
+        return -1;
+
+    int slot = keymap_slot(map, key);
+    if (slot) {
+        map->actions[slot - 1] |= 1 << action;
+        return 0;
+    }
+    if (map->slots == KEYMAP_SLOTS)
+        return -1;
+
+    slot = ++map->slots;
+    map->actions[slot - 1] = 1 << action;
+    if (key < KEYMAP_DIRECT) {
+        map->direct[key] = slot;
+        return 0;
+    }
+    uint32_t h = hash(key);
+    while (map->hash_keys[h])
+        h = (h + 1) % KEYMAP_HASH;
+    map->hash_keys[h] = key;
+    map->hash_slots[h] = slot;
+    return 0;
+}
+
+int keymap_slot(const Keymap *map, uint32_t key) {
+    if (key < KEYMAP_DIRECT)
+        return map->direct[key];
+    for (uint32_t h = hash(key); map->hash_keys[h]; h = (h + 1) % KEYMAP_HASH)
+        if (map->hash_keys[h] == key)
+            return map->hash_slots[h];
+    return 0;
+}
+
+uint16_t keymap_actions(const Keymap *map, uint64_t down) {
+    uint16_t actions = 0;
+    for (; down; down &= down - 1)
+        actions |= map->actions[__builtin_ctzll(down)];
+    return actions;
+}
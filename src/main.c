@@ -1,784 +1,648 @@
 #include <curses.h>
 #include <sys/ioctl.h>
 #include <termios.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <linux/kd.h>
 #include <locale.h>
+#include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include "input.h"
 #include "config.h"
+#include "board.h"
+#include "draw.h"
+#include "timing.h"
+#include "core.h"
+#include "replay.h"
+#include "bot.h"
+#include "pc.h"
+#include "perf.h"
+#include "versus.h"
+#include "spectate.h"
+#include "history.h"
 
-#define BOARD_HEIGHT 20
-#define ARR_HEIGHT 40
-#define BOARD_WIDTH 10
 #define WIDTH 38 + 7 + 1 + BOARD_WIDTH * 2 + 1 + 9
 #define HEIGHT BOARD_HEIGHT + 6
 #define RIGHT_MARGIN 46
-
-#define SPAWN_X 4
-#define SPAWN_Y 19
-#define SPAWN_ROT 0
-#define FPS 60
-#define DAS 5
-#define CLEAR_GOAL 40
-#define QUEUE_SZ 5
-#define BAG_SZ 7
-
-#define LEFT 0
-#define RIGHT 1
-#define SD 2
-#define HD 3
-#define CCW 4
-#define CW 5
-#define FLIP 6
-#define HOLD 7
-#define RESET 8
-#define QUIT 9
-
-#define COLOR_ORANGE 8
-
-typedef struct Piece {
-    int8_t x;
-    int8_t y;
-    int8_t coords[4][2];
-    uint8_t type;
-    uint8_t rot;
-} Piece;
-
-// TODO: figure out better way to store this
-// Defined by offset from the piece center
-// 7 pieces, 4 rotations, 3 coordinate pairs
-const int8_t pieces[BAG_SZ][4][4][2] = {
-    // I
-    {
-        {{-1, 0}, {0, 0}, {1, 0}, {2, 0}},
-        // []<>[][]
-        {{0, -1}, {0, 0}, {0, 1}, {0, 2}},
-        // []
-        // <>
-        // []
-        // []
-        {{-2, 0}, {-1, 0}, {0, 0}, {1, 0}},
-        // [][]<>[]
-        {{0, -2}, {0, -1}, {0, 0}, {0, 1}},
-        // []
-        // []
-        // <>
-        // []
-    },
-    // J
-    {
-        {{-1, -1}, {-1, 0}, {0, 0}, {1, 0}},
-         // []
-         // []<>[]
-        {{0, -1}, {1, -1}, {0, 0}, {0, 1}},
-         // [][]
-         // <>
-         // []
-        {{-1, 0}, {0, 0}, {1, 0}, {1, 1}},
-         // []<>[]
-         //     []
-        {{0, -1}, {0, 0}, {-1, 1}, {0, 1}},
-         //   []
-         //   <>
-         // [][]
-    },
-    // L
-    {
-        {{1, -1}, {-1, 0}, {0, 0}, {1, 0}},
-        //     []
-        // []<>[]
-        {{0, -1}, {0, 0}, {0, 1}, {1, 1}},
-        // []
-        // <>
-        // [][]
-        {{-1, 0}, {0, 0}, {1, 0}, {-1, 1}},
-        // []<>[]
-        // []
-        {{-1, -1}, {0, -1}, {0, 0}, {0, 1}},
-        // [][]
-        //   <>
-        //   []
-    },
-    // O
-    {
-        {{0, -1}, {1, -1}, {0, 0}, {1, 0}},
-        // [][]
-        // <>[]
-        {{0, 0}, {1, 0}, {0, 1}, {1, 1}},
-        // <>[]
-        // [][]
-        {{-1, 0}, {0, 0}, {-1, 1}, {0, 1}},
-        // []<>
-        // [][]
-        {{-1, -1}, {0, -1}, {-1, 0}, {0, 0}}
-        // [][]
-        // []<>
-    },
-    // S
-    {
-        {{0, -1}, {1, -1}, {-1, 0}, {0, 0}},
-        //   [][]
-        // []<>
-        {{0, -1}, {0, 0}, {1, 0}, {1, 1}},
-        // []
-        // <>[]
-        //   []
-        {{0, 0}, {1, 0}, {-1, 1}, {0, 1}},
-        //   <>[]
-        // [][]
-        {{-1, -1}, {-1, 0}, {0, 0}, {0, 1}}
-        // []
-        // []<>
-        //   []
-    },
-    // T
-    {
-        {{0, -1}, {-1, 0},{0, 0},  {1, 0}},
-        //   []
-        // []<>[]
-        {{0, -1}, {0, 0}, {1, 0}, {0, 1}},
-        // []
-        // <>[]
-        // []
-        {{-1, 0}, {0, 0}, {1, 0}, {0, 1}},
-        // []<>[]
-        //   []
-        {{0, -1}, {-1, 0}, {0, 0}, {0, 1}}
-        //   []
-        // []<>
-        //   []
-    },
-    // Z
-    {
-        {{-1, -1}, {0, -1}, {0, 0}, {1, 0}},
-        // [][]
-        //   <>[]
-        {{1, -1}, {0, 0}, {1, 0}, {0, 1}},
-        //   []
-        // <>[]
-        // []
-        {{-1, 0}, {0, 0}, {0, 1}, {1, 1}},
-        // []<>
-        //   [][]
-        {{0, -1}, {-1, 0}, {0, 0}, {-1, 1}}
-        //   []
-        // []<>
-        // []
-    },
+// The other player's board in versus, right of the queue
+#define PEER_X (RIGHT_MARGIN + BOARD_WIDTH * 2 + 12)
+#define VERSUS_WIDTH (PEER_X + BOARD_WIDTH * 2 + 3)
+
+// Launch phases for --startup-trace, ns since main was entered
+enum StartupPoint {
+    T_CURSES,
+    T_INPUT,
+    T_CONFIG,
+    T_SETUP,
+    T_FIRST_FRAME,
+    T_PLAYABLE,
+    T_POINTS
 };
 
-// 3 offset 'classes', 4 rotation states, 5 x & y offsets
-const int8_t offsets[3][4][5][2] = {
-    // J, L, S, T, Z
-    {
-        // Spawn
-        {{ 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
-        // CW
-        {{ 0, 0}, { 1, 0}, { 1,-1}, { 0, 2}, { 1, 2}},
-        // 180
-        {{ 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
-        // CCW
-        {{ 0, 0}, {-1, 0}, {-1,-1}, { 0, 2}, {-1, 2}},
-    },
-    // I
-    {
-        // Spawn
-        {{ 0, 0}, {-1, 0}, { 2, 0}, {-1, 0}, { 2, 0}},
-        // CW
-        {{-1, 0}, { 0, 0}, { 0, 0}, { 0, 1}, { 0,-2}},
-        // 180
-        {{-1, 1}, { 1, 1}, {-2, 1}, { 1, 0}, {-2, 0}},
-        // CCW
-        {{ 0, 1}, { 0, 1}, { 0, 1}, { 0,-1}, { 0, 2}},
-    },
-    // O
-    {
-        // Spawn
-        {{ 0, 0}},
-        // CW
-        {{ 0,-1}},
-        // 180
-        {{-1,-1}},
-        // CCW
-        {{-1, 0}},
-    },
+static const char *startup_names[T_POINTS] = {
+    [T_CURSES]      = "curses",
+    [T_INPUT]       = "input mode",
+    [T_CONFIG]      = "config",
+    [T_SETUP]       = "setup",
+    [T_FIRST_FRAME] = "first frame",
+    [T_PLAYABLE]    = "playable",
 };
 
-// 180 offset table
-const int8_t offsets2[2][4][2][2] = {
-    {
-        // Spawn
-        {{ 0, 0}, { 0, 1}},
-        // CW
-        {{ 0, 0}, { 1, 0}},
-        // 180
-        {{ 0, 0}, { 0, 0}},
-        // CCW
-        {{ 0, 0}, { 0, 0}}
-    },
-    {
-        // Spawn
-        {{ 1, 0}, { 1, 0}},
-        // CW
-        {{-1, 0}, { 0, 0}},
-        // 180
-        {{ 0, 1}, { 0, 0}},
-        // CCW
-        {{ 0, 1}, { 0, 1}},
-    }
+static const char *mode_names[MODES] = {
+    [EXTKEYS]   = "extkeys",
+    [SCANCODES] = "scan",
+    [NORM]      = "norm",
+    [EVDEV]     = "evdev",
 };
 
-void init_curses () {
-    initscr();
-    raw();
-    curs_set(0);
-    start_color();
-    noecho();
-    use_default_colors();
-    nodelay(stdscr, 1);
-
-    // Base pieces
-    init_pair(1,  COLOR_CYAN,    -1);
-    init_pair(2,  COLOR_BLUE,    -1);
-    init_pair(3,  COLOR_WHITE,   -1);
-    init_pair(4,  COLOR_YELLOW,  -1);
-    init_pair(5,  COLOR_GREEN,   -1);
-    init_pair(6,  COLOR_MAGENTA, -1);
-    init_pair(7,  COLOR_RED,     -1);
-
-    // End screen board + pressed key bg
-    init_pair(8,  COLOR_WHITE,   -1);
-
-    // Pressed key text
-    init_pair(9,  COLOR_BLUE,    COLOR_WHITE);
-
-    // Base key text
-    init_pair(10, COLOR_WHITE,   COLOR_BLUE);
-
-    // Base key bg
-    init_pair(11, COLOR_BLUE,    -1);
-
-    // Make orange if supported
-    if (COLORS > 8) {
-        init_color(COLOR_ORANGE, 816, 529, 439);
-        init_pair(3,  COLOR_ORANGE,  -1);
-    }
-}
+static uint64_t launch;
+static uint64_t startup_at[T_POINTS];
 
-time_t get_ms() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-    return ((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
-}
-
-int8_t check_collide(int8_t board[ARR_HEIGHT][BOARD_WIDTH], int8_t x, int8_t y, int8_t type, int8_t rot) {
-    for (int i = 0; i < 4; i++) {
-        int minoY = y - pieces[type][rot][i][1];
-        int minoX = x + pieces[type][rot][i][0];
-        if (minoY >= ARR_HEIGHT
-          || minoX >= BOARD_WIDTH
-          || minoX < 0
-          || minoY < 0
-          || board[minoY][minoX])
-            return 1;
-    }
-    return 0;
+// Only the first time counts, later games reach the same points
+static void startup_mark(int point) {
+    if (!startup_at[point])
+        startup_at[point] = get_ns() - launch;
 }
 
-void move_piece(int8_t board[ARR_HEIGHT][BOARD_WIDTH], Piece *p, int8_t h, int8_t amount) {
-    int8_t collision = 0;
-    int8_t last_x = p->x;
-    int8_t last_y = p->y;
-    int8_t step = (amount < 0) ? -1 : 1;
-
-    for (int8_t i = step; i != amount + step; i += step) {
-        int8_t x = p->x + (h ? i : 0);
-        int8_t y = p->y + (h ? 0 : i);
-
-        collision = check_collide(board, x, y, p->type, p->rot);
-
-        if (!collision) {
-            last_x = x;
-            last_y = y;
-        } else
-            break;
-    }
-
-    p->x = last_x;
-    p->y = last_y;
-
-    for (int8_t i = 0; i < 4; i++) {
-        p->coords[i][0] = p->x + pieces[p->type][p->rot][i][0];
-        p->coords[i][1] = p->y - pieces[p->type][p->rot][i][1];
-    }
+static void write_startup(FILE *f, Config *config) {
+    fprintf(f, "Startup, ms since launch\n");
+    for (int i = 0; i < T_POINTS; i++)
+        if (startup_at[i])
+            fprintf(f, "%12s %9.3f\n", startup_names[i], (double) startup_at[i] / NS_PER_MS);
+    if (startup_at[T_PLAYABLE] && config->countdown)
+        fprintf(f, "%12s %9.3f (countdown)\n", "", (double) config->countdown);
+
+    const InputProbe *p = input_probe();
+    fprintf(f, "Input mode %s, %s in %.3fms\n", mode_names[p->mode],
+        p->cached ? "cached" : "probed", (double) (p->end - p->start) / NS_PER_MS);
+    if (p->verified && p->changed)
+        fprintf(f, "Checked at %.3fms, switched to %s\n", (double) (p->verified - launch) / NS_PER_MS,
+            mode_names[config->mode]);
+    else if (p->verified)
+        fprintf(f, "Checked at %.3fms, as cached\n", (double) (p->verified - launch) / NS_PER_MS);
 }
 
-void spin_piece(int8_t board[ARR_HEIGHT][BOARD_WIDTH], Piece *p, int8_t spin) {
-    // 0 = cw
-    // 1 = 180
-    // 2 = ccw
-    int8_t init_rot = p->rot;
-    int8_t class = 0;
-    if (p->type == 0) class = 1;
-    if (p->type == 3) class = 2;
-    p->rot = (p->rot + spin + 1) % 4;
-
-    int8_t collision = 0;
-    for (int8_t i = 0; i < 5; i++) {
-        int8_t x = p->x + (offsets[class][init_rot][i][0] - offsets[class][p->rot][i][0]);
-        int8_t y = p->y + (offsets[class][init_rot][i][1] - offsets[class][p->rot][i][1]);
-
-        if (class != 2 && spin == 1) {
-            x = p->x + (offsets2[class][init_rot][i][0] - offsets2[class][p->rot][i][0]);
-            y = p->y + (offsets2[class][init_rot][i][1] - offsets2[class][p->rot][i][1]);
-            if (i > 2)
-                break;
-        }
-
-        collision = check_collide(board, x, y, p->type, p->rot);
-
-        if (!collision) {
-            p->x = x;
-            p->y = y;
-            break;
-        }
-    }
-
-    if (collision) {
-        p->rot = init_rot;
+// Writes a recorded run to the replay dir, named by when it ended
+static void save_replay(Replay *r) {
+    char path[4096];
+    if (replay_dir(path, sizeof(path) - 32))
         return;
-    }
-
-    for (int8_t i = 0; i < 4; i++) {
-        p->coords[i][0] = p->x + pieces[p->type][p->rot][i][0];
-        p->coords[i][1] = p->y - pieces[p->type][p->rot][i][1];
-    }
-
-}
-
-void draw_gui(int8_t x, int8_t y) {
-    for (int8_t i = BOARD_HEIGHT - 1; i >= 0; i--) {
-        mvprintw(y + i, x, "█");
-        mvprintw(y + i, x + 1 + BOARD_WIDTH * 2, "█");
-    }
-    for (int8_t i = 0; i < BOARD_WIDTH + 1; i++)
-        mvprintw(y + BOARD_HEIGHT, x + i * 2, "▀▀");
-    refresh();
+    time_t now = time(NULL);
+    size_t len = strlen(path);
+    len += strftime(path + len, sizeof(path) - len, "/%Y%m%d-%H%M%S", localtime(&now));
+    snprintf(path + len, sizeof(path) - len, "-%08x.ttr", r->seed);
+    replay_save(r, path);
 }
 
-void draw_piece(WINDOW *w, int8_t x, int8_t y, int8_t type, int8_t rot, int8_t ghost) {
-    for (int8_t i = 0; i < 4; i++) {
-        wattron(w, COLOR_PAIR(type + 1));
-        mvwprintw(w,
-                  y + pieces[type][rot][i][1],
-                  2 * (x + pieces[type][rot][i][0]),
-                  ghost ? "▓▓" : "██"
-        );
-        wattroff(w, COLOR_PAIR(type + 1));
+// Feeds timestamped key transitions to the game and the recording, and any
+// garbage they send to vs stamped with the key's time
+static void apply_events(GameState *s, Replay *rec, Versus *vs, InputEvents *events, uint64_t start_time) {
+    // Events are applied in the order and at the time they arrived, so taps
+    // shorter than a frame still register and DAS charges from the keypress.
+    // Keys held since before the start count from the start
+    for (int i = 0; i < events->n; i++) {
+        InputEvent *e = &events->ev[i];
+        uint64_t time = e->time > start_time ? e->time - start_time : 0;
+        int sent = s->sent;
+        core_input(s, e->key, e->pressed, time);
+        replay_record(rec, s->time, s->inputs & 0xff);
+        if (vs && s->sent != sent)
+            versus_garbage(vs, s->sent - sent, e->time);
     }
 }
 
-void draw_board(WINDOW *w, int8_t board[ARR_HEIGHT][BOARD_WIDTH], Piece *p, int8_t line, int8_t mono) {
-    werase(w);
-
-    int8_t orig_y = p->y;
-    move_piece(board, p, 0, -p->y);
-    int8_t ghost_y = p->y;
-    p->y = orig_y;
-
-    for (int8_t i = 0; i < BOARD_HEIGHT; i++) {
-        for (int8_t j = 0; j < BOARD_WIDTH; j++) {
-            if (board[i][j]) {
-                wattron(w, COLOR_PAIR(mono ? 8 : board[i][j]));
-                mvwprintw(w, BOARD_HEIGHT - 1 - i, 2 * j, mono ? "▓▓" : "██");
-                wattroff(w, COLOR_PAIR(mono ? 8 : board[i][j]));
-            } else if (i == line) {
-                mvwprintw(w, BOARD_HEIGHT - 1 - i, 2 * j, "__");
-            }
-        }
-    }
-
-    if (!mono) {
-        draw_piece(w, p->x, BOARD_HEIGHT - 1 - ghost_y, p->type, p->rot, 1);
-        draw_piece(w, p->x, BOARD_HEIGHT - 1 - p->y, p->type, p->rot, 0);
-    }
-    wrefresh(w);
+// Everything that outlasts a game, so a reset only clears the state and
+// redraws what changed
+typedef struct Session {
+    // Size and mode the panels were laid out for
+    int cols;
+    int lines;
+    int8_t versus;
+    int8_t laid_out;
+    int offset_x;
+    int offset_y;
+    Panel board_win, queue_win, hold_win, key_win, stat_win, fin_win, pc_win, perf_win, garbage_win, peer_win;
+    GameState state;
+    // Recording buffer, reused by every game
+    Replay rec;
+} Session;
+
+static void session_init(Session *ss, Config *config) {
+    memset(ss, 0, sizeof(*ss));
+    replay_init(&ss->rec, config, 0);
 }
 
-void draw_queue(WINDOW *w, int8_t queue[], int8_t queue_pos) {
-    werase(w);
-    for (int8_t i = 0; i < QUEUE_SZ; i++) {
-        draw_piece(w, 1, 2 + 3 * i, queue[queue_pos], 0, 0);
-        queue_pos = (queue_pos + 1) % BAG_SZ;
-    }
-    wrefresh(w);
+static void session_unlay(Session *ss) {
+    if (!ss->laid_out)
+        return;
+    panel_free(&ss->board_win);
+    panel_free(&ss->queue_win);
+    panel_free(&ss->hold_win);
+    panel_free(&ss->key_win);
+    panel_free(&ss->stat_win);
+    panel_free(&ss->fin_win);
+    panel_free(&ss->pc_win);
+    panel_free(&ss->perf_win);
+    panel_free(&ss->garbage_win);
+    panel_free(&ss->peer_win);
+    draw_clear();
+    ss->laid_out = 0;
 }
 
-void draw_hold(WINDOW *w, int8_t p, int8_t held) {
-    werase(w);
-    if (p != -1) {
-        draw_piece(w, 1, 1, p, 0, held);
-    }
-    wrefresh(w);
+static void session_free(Session *ss) {
+    session_unlay(ss);
+    replay_free(&ss->rec);
 }
 
-void draw_keys(WINDOW *w, int8_t inputs[KEYS]) {
-    werase(w);
-    // by top left corner (y, x)
-    const int key_pos[KEYS - 2][2] = {
-        { 4, 23 },
-        { 4, 28 },
-        { 4, 33 },
-        { 4, 15 },
-        { 0,  5 },
-        { 0, 10 },
-        { 0, 15 },
-        { 2,  0 },
-    };
-
-    const char *key_chars[KEYS - 2] = {
-        "←",
-        "→",
-        "↓",
-        "▼",
-        "(",
-        ")",
-        "/",
-        "↕"
-    };
-
-    // base key display
-    wattron(w, COLOR_PAIR(11));
-    for (int i = 0; i < KEYS - 2; i++) {
-        mvwprintw(w, key_pos[i][0]    , key_pos[i][1], "▄▄▄▄▄");
-        mvwprintw(w, key_pos[i][0] + 2, key_pos[i][1], "▀▀▀▀▀");
-    }
-    wattroff(w, COLOR_PAIR(11));
-
-    wattron(w, COLOR_PAIR(10));
-    for (int i = 0; i < KEYS - 2; i++) {
-        mvwprintw(w, key_pos[i][0] + 1, key_pos[i][1], "  %s  ", key_chars[i]);
-    }
-    wattroff(w, COLOR_PAIR(10));
-
-    // pressed keys
-    wattron(w, COLOR_PAIR(8));
-    for (int i = 0; i < KEYS - 2; i++) {
-        if (inputs[i]) {
-            mvwprintw(w, key_pos[i][0]    , key_pos[i][1], "▄▄▄▄▄");
-            mvwprintw(w, key_pos[i][0] + 2, key_pos[i][1], "▀▀▀▀▀");
-        }
-    }
-    wattroff(w, COLOR_PAIR(8));
-
-    wattron(w, COLOR_PAIR(9));
-    for (int i = 0; i < KEYS - 2; i++) {
-        if (inputs[i]) {
-            mvwprintw(w, key_pos[i][0] + 1, key_pos[i][1], "  %s  ", key_chars[i]);
-        }
+// Makes the panels for the terminal's current size, unless they already fit
+// Returns 2 if it is too small
+static int8_t session_layout(Session *ss, int8_t versus) {
+    draw_resize();
+    if (ss->laid_out && ss->cols == COLS && ss->lines == LINES && ss->versus == versus)
+        return 0;
+    session_unlay(ss);
+    if (COLS < (versus ? VERSUS_WIDTH : WIDTH) || LINES < HEIGHT) {
+        return 2;
     }
-    wattroff(w, COLOR_PAIR(9));
-
-    wrefresh(w);
-}
 
-void draw_stats(WINDOW *w, int time, int pieces, int keys, int holds) {
-    werase(w);
+    // center board
+    int offset_x = (COLS - BOARD_WIDTH * 2) / 2 - RIGHT_MARGIN;
+    int offset_y = (LINES - HEIGHT) / 2 - 6;
 
-    int min = time / 60000;
-    int sec = (time / 1000) % 60;
-    int csec = (time / 10) % 100;
+    if (versus && offset_x + VERSUS_WIDTH > COLS)
+        offset_x = COLS - VERSUS_WIDTH;
+    if (offset_x < 0)
+        offset_x = 0;
 
-    if (min)
-        mvwprintw(w, 0, 0, "%6s %d:%02d.%d", "Time", min, sec, csec);
-    else
-        mvwprintw(w, 0, 0, "%6s %d.%d", "Time", sec, csec);
+    if (offset_y < 0)
+        offset_y = 0;
 
-    mvwprintw(w, 1, 0, "%6s %.2f", "PPS", pieces ? pieces / ((float) time / 1000) : 0);
-    mvwprintw(w, 2, 0, "%6s %.2f", "KPP", pieces ? (float) keys / pieces : 0);
-    mvwprintw(w, 3, 0, "%6s %d", "Hold", holds);
-    mvwprintw(w, 4, 0, "%6s %d", "#", pieces);
-    wrefresh(w);
+    panel_init(&ss->board_win, BOARD_HEIGHT, BOARD_WIDTH * 2, offset_y, offset_x + RIGHT_MARGIN);
+    panel_init(&ss->queue_win, 15, 4 * 2, offset_y, offset_x + RIGHT_MARGIN + BOARD_WIDTH * 2 + 2);
+    panel_init(&ss->hold_win, 2, 4 * 2, offset_y + 1, offset_x + 36);
+    panel_init(&ss->key_win, 7, 38, offset_y + 3, offset_x);
+    panel_init(&ss->stat_win, 5, 27, offset_y + BOARD_HEIGHT + 1, offset_x + RIGHT_MARGIN + 3);
+    panel_init(&ss->fin_win, 2, 38, offset_y + 11, offset_x);
+    panel_init(&ss->pc_win, 1 + PC_MAX_HEIGHT, 38, offset_y + 14, offset_x);
+    panel_init(&ss->perf_win, 5, 38, offset_y + BOARD_HEIGHT + 1, offset_x);
+    panel_init(&ss->garbage_win, BOARD_HEIGHT, 1, offset_y, offset_x + RIGHT_MARGIN - 2);
+    panel_init(&ss->peer_win, BOARD_HEIGHT + 2, BOARD_WIDTH * 2 + 3, offset_y, offset_x + PEER_X);
+    ss->cols = COLS;
+    ss->lines = LINES;
+    ss->versus = versus;
+    ss->offset_x = offset_x;
+    ss->offset_y = offset_y;
+    ss->laid_out = 1;
+    return 0;
 }
 
-void lock_piece(int8_t board[ARR_HEIGHT][BOARD_WIDTH], Piece *p) {
-    for (int8_t i = 0; i < 4; i++)
-        board[p->coords[i][1]][p->coords[i][0]] = p->type + 1;
-}
+// Plays a game in ss, or shows a replay in real time if playback is set
+// With a bot, its moves replace the keyboard apart from reset and quit
+// The solve key asks pc for a perfect clear, if it is set
+// Frame timings are added to perf
+// With vs, garbage is traded with the other player and their board is shown
+// Every frame is published to sp for spectators, if it is set
+// Splits are compared with hist, and finished sprints played by hand added
+// to it
+int8_t game(Session *ss, Config *config, int *fd, Replay *playback, Bot *bot, PcSolver *pc, Perf *perf, Versus *vs, Spectate *sp, History *hist) {
+    if (session_layout(ss, vs != NULL))
+        return 2;
+    int offset_x = ss->offset_x;
+    int offset_y = ss->offset_y;
 
-void gen_piece(Piece *p, int8_t type) {
-    p->type = type;
-    p->rot = SPAWN_ROT;
-    p->x = SPAWN_X;
-    p->y = SPAWN_Y;
-    for (int8_t i = 0; i < 4; i++) {
-        p->coords[i][0] = p->x + pieces[type][0][i][0];
-        p->coords[i][1] = p->y - pieces[type][0][i][1];
-    }
-}
+    GameState *s = &ss->state;
+    uint32_t seed = playback ? playback->seed : (uint32_t) (get_ns() ^ time(NULL));
+    core_init(s, config, seed);
+    s->versus = vs != NULL;
 
-int8_t queue_pop(Piece *p, int8_t queue[], int8_t queue_pos) {
-    gen_piece(p, queue[queue_pos]);
+    // Recorded in memory, the file is only written once the game is over
+    Replay *rec = &ss->rec;
+    if (!playback)
+        replay_restart(rec, config, seed);
 
-    int8_t rand = random() % (BAG_SZ - queue_pos);
-    int8_t used[BAG_SZ] = {0};
-    int8_t bag[BAG_SZ];
-    int8_t bag_pos = 0;
+    InputState inputs = { 0 };
+    InputEvents events = { 0 };
+    // The plan only holds for the position it was asked for, pieces and
+    // holds together change whenever that does
+    PcResult plan = { .status = PC_IDLE };
+    int asked_at = 0;
 
-    for (int8_t i = 0; i < queue_pos; i++)
-        used[queue[i]] = 1;
+    int poll_fd = input_fd(config, *fd);
 
-    for (int8_t i = 0; i < BAG_SZ; i++)
-        if (!used[i])
-            bag[bag_pos++] = i;
+    draw_gui(offset_x + 45, offset_y);
 
-    queue[queue_pos] = bag[rand];
-    return (queue_pos + 1) % BAG_SZ;
+    draw_queue(&ss->queue_win, s->queue, s->queue_pos);
+    draw_hold(&ss->hold_win, s->hold, s->hold_used);
+    draw_keys(&ss->key_win, 0);
+    HistoryStats hs;
+    if (hist)
+        history_stats(hist, s, &hs);
+    draw_stats(&ss->stat_win, 0, 0, 0, 0, hist ? &hs : NULL);
+    draw_finesse(&ss->fin_win, 0, 0, 0, NULL);
+    draw_pc(&ss->pc_win, &plan);
+    if (perf->overlay)
+        draw_perf(&ss->perf_win, perf);
+    if (vs) {
+        versus_reset(vs);
+        draw_garbage(&ss->garbage_win, 0);
+        draw_peer(&ss->peer_win, &vs->peer);
+    }
+    draw_flush();
+    startup_mark(T_FIRST_FRAME);
+
+    // Without one, the last game's board stays up until the first frame
+    if (config->countdown) {
+        panel_blank(&ss->board_win);
+        draw_flush();
+        draw_text(offset_y + 11, offset_x + 53, "READY");
+        usleep(config->countdown * 500);
+        draw_text(offset_y + 11, offset_x + 53, " GO! ");
+        usleep(config->countdown * 500);
+        panel_blank(&ss->board_win);
+    }
 
-}
+    Scheduler sched;
+    sched_init(&sched, NS_PER_SEC / FPS);
+    uint64_t start_time = get_ns();
+    startup_mark(T_PLAYABLE);
+
+    core_start(s);
+    if (sp)
+        spectate_new_game(sp);
+
+    // Keys shown in the overlay, the replay's own during playback
+    uint16_t shown = 0;
+    int8_t ended = 0;
+    uint64_t next_piece = 0;
+    // Times of the garbage that arrived this frame, for perf once it's shown
+    uint64_t arrived[VERSUS_QUEUE];
+    int n_arrived = 0;
+    int pieces = 0;
 
-void queue_init (int8_t queue[]) {
-    int8_t bag[BAG_SZ];
-    for (int8_t i = 0; i < BAG_SZ; i++)
-        bag[i] = i;
 
-    for (int8_t i = BAG_SZ - 1; i > 0; i--) {
-        int8_t rand = random() % (i + 1);
-        queue[BAG_SZ - 1 - i] = bag[rand];
-        bag[rand] = bag[i];
-    }
+    // Game Loop
+    while (!s->done) {
+        uint64_t read = get_ns();
+        get_inputs(config, *fd, &inputs, &events);
+        // A mode from the cache is used before the terminal has confirmed it
+        if (input_verify(config, fd)) {
+            config_keymap(config);
+            poll_fd = input_fd(config, *fd);
+        }
 
-    queue[BAG_SZ - 1] = bag[0];
-}
+        if (inputs.actions & (1 << RESET | 1 << QUIT))
+            break;
 
-int8_t clear_lines(int8_t board[ARR_HEIGHT][BOARD_WIDTH]) {
-    int8_t cleared = 0;
-    for (int8_t i = 0; i < ARR_HEIGHT; i++) {
-        int8_t clear = 1;
-        for (int8_t j = 0; j < BOARD_WIDTH; j++) {
-            if (!board[i][j]) {
-                clear = 0;
+        n_arrived = 0;
+        if (vs) {
+            versus_poll(vs);
+            for (int i = 0; i < vs->n_in; i++) {
+                // Sent at a game that has since been reset, or during the
+                // countdown
+                if (vs->in[i].time < start_time)
+                    continue;
+                core_garbage(s, vs->in[i].lines, vs->in[i].hole);
+                arrived[n_arrived++] = vs->in[i].time;
+            }
+            vs->n_in = 0;
+            // The other player topping out ends it like reaching the goal
+            if (vs->peer.lost) {
+                ended = 1;
                 break;
             }
         }
-        if (clear) {
-            cleared++;
-            continue;
-        } if (cleared) {
-            for (int8_t j = 0; j < BOARD_WIDTH; j++) {
-                board[i-cleared][j] = board[i][j];
-                if (i >= ARR_HEIGHT - cleared)
-                    board[i][j] = 0;
-                board[ARR_HEIGHT-1][j] = 0;
+
+        for (int i = 0; pc && i < events.n; i++) {
+            if (events.ev[i].key == SOLVE && events.ev[i].pressed) {
+                plan.id = pc_request(pc, s);
+                plan.status = PC_SOLVING;
+                asked_at = s->pieces + s->holds;
             }
         }
-    }
-    return cleared;
-}
 
-int8_t game(Config *config, int fd) {
-    if (COLS < WIDTH || LINES < HEIGHT) {
-        return 2;
-    }
-
-    // center board
-    int offset_x = (COLS - BOARD_WIDTH * 2) / 2 - RIGHT_MARGIN;
-    int offset_y = (LINES - HEIGHT) / 2 - 6;
+        uint64_t now = get_ns() - start_time;
+        if (playback) {
+            uint64_t time;
+            uint8_t mask;
+            while (replay_peek(playback, &time) && time <= now) {
+                replay_next(playback, &time, &mask);
+                replay_apply(s, s->inputs, mask, time);
+            }
+            // An abandoned run stops where it was reset
+            if (!s->done && !replay_peek(playback, &time)
+              && now >= (uint64_t) playback->time_us * CORE_RES) {
+                core_advance(s, (uint64_t) playback->time_us * CORE_RES);
+                ended = 1;
+                break;
+            }
+            shown = s->inputs;
+        } else if (bot) {
+            // One placement at a time, as fast as the bot can think or at
+            // the configured pps, and only for half a frame so drawing keeps
+            // up. Its keys go through the same path as the keyboard's
+            uint64_t budget = get_ns() + NS_PER_SEC / FPS / 2;
+            while (!s->done && now >= next_piece && get_ns() < budget) {
+                BotMove move;
+                if (!bot_think(bot, s, &move))
+                    break;
+
+                uint64_t base = get_ns() - start_time;
+                if (base < s->time)
+                    base = s->time;
+                InputEvents moves = { .n = 0 };
+                for (int i = 0; i < move.n && i < MAX_EVENTS; i++) {
+                    BotEvent *e = &move.ev[i];
+                    moves.ev[moves.n++] = (InputEvent) { start_time + base + e->time, e->key, e->pressed };
+                }
+                apply_events(s, rec, vs, &moves, start_time);
+                if (config->bot_pps)
+                    next_piece = base + NS_PER_SEC / config->bot_pps;
+            }
+            shown = s->inputs;
+        } else {
+            apply_events(s, rec, vs, &events, start_time);
+            shown = inputs.actions;
+        }
+        if (vs) {
+            if (s->pieces != pieces)
+                versus_piece(vs, s->pieces, s->cleared, s->sent);
+            versus_board(vs, &s->board, &s->curr, core_pending(s));
+            if (s->topped_out)
+                versus_lost(vs);
+        }
+        pieces = s->pieces;
+        if (s->done)
+            break;
 
-    if (offset_x < 0)
-        offset_x = 0;
+        core_advance(s, now);
 
-    if (offset_y < 0)
-        offset_y = 0;
+        if (pc && plan.status == PC_SOLVING)
+            pc_poll(pc, &plan);
+        if (plan.status != PC_IDLE && s->pieces + s->holds != asked_at)
+            plan.status = PC_IDLE;
+        if (sp)
+            spectate_publish(sp, s);
+        uint64_t update = get_ns();
 
-    WINDOW *board_win = newwin(BOARD_HEIGHT, BOARD_WIDTH * 2, offset_y, offset_x + RIGHT_MARGIN);
-    WINDOW *queue_win = newwin(15, 4 * 2, offset_y, offset_x + RIGHT_MARGIN + BOARD_WIDTH * 2 + 2);
-    WINDOW *hold_win = newwin(2, 4 * 2, offset_y + 1, offset_x + 36);
-    WINDOW *key_win = newwin(7, 38, offset_y + 3, offset_x);
-    WINDOW *stat_win = newwin(5, 14, offset_y + BOARD_HEIGHT + 1, offset_x + RIGHT_MARGIN + 3);
-
-    Piece *curr = malloc(sizeof(Piece));
-    int8_t board[ARR_HEIGHT][BOARD_WIDTH];
-    for (int8_t i = 0; i < ARR_HEIGHT; i++)
-        for (int8_t j = 0; j < BOARD_WIDTH; j++)
-            board[i][j] = 0;
-
-    int8_t hold = -1;
-    int8_t hold_used = 0;
-    int8_t queue[BAG_SZ];
-    queue_init(queue);
-    int8_t queue_pos = 0;
-    int8_t inputs[KEYS] = {0};
-    int8_t last_inputs[KEYS] = {0};
-
-    float grav = 0.02;
-    float grav_c = 0;
-    int8_t ldas_c = 0;
-    int8_t rdas_c = 0;
+        // Updates
+        draw_board(&ss->board_win, &s->board, &s->curr, CLEAR_GOAL - s->cleared, 0);
+        draw_queue(&ss->queue_win, s->queue, s->queue_pos);
+        draw_hold(&ss->hold_win, s->hold, s->hold_used);
+        draw_keys(&ss->key_win, shown);
+        if (hist)
+            history_stats(hist, s, &hs);
+        draw_stats(&ss->stat_win, s->time, s->pieces, s->keys, s->holds, hist ? &hs : NULL);
+        draw_finesse(&ss->fin_win, s->faults, s->fault, s->last_keys, &s->finesse);
+        draw_pc(&ss->pc_win, &plan);
+        if (perf->overlay)
+            draw_perf(&ss->perf_win, perf);
+        if (vs) {
+            draw_garbage(&ss->garbage_win, core_pending(s));
+            draw_peer(&ss->peer_win, &vs->peer);
+        }
+        draw_flush();
+        uint64_t render = get_ns();
+        perf_frame(perf, &events, read, update, render);
+        for (int i = 0; i < n_arrived; i++)
+            hist_add(&perf->garbage, render > arrived[i] ? render - arrived[i] : 0);
+
+        uint64_t late = sched.late;
+        // Garbage wakes the loop like a key does
+        int wake[3] = { poll_fd, vs ? vs->fd : -1, vs && vs->fd < 0 ? vs->listen_fd : -1 };
+        sched_wait_any(&sched, wake, 3);
+        perf->missed += sched.late - late;
+    }
 
-    int pieces = 0;
-    int holds = 0;
-    int keys = 0;
-    int keys_tmp = 0;
-    int cleared = 0;
+    if (!playback) {
+        // Garbage isn't recorded, so a versus game couldn't be replayed
+        if (s->pieces && !vs) {
+            replay_finish(rec, s);
+            save_replay(rec);
+        }
+    }
 
-    mvprintw(offset_y + 11, offset_x + 53, "READY");
-    draw_gui(offset_x + 45, offset_y);
+    if (sp)
+        spectate_publish(sp, s);
 
-    draw_queue(queue_win, queue, queue_pos);
-    draw_hold(hold_win, hold, hold_used);
-    draw_keys(key_win, inputs);
-    draw_stats(stat_win, 0, 0, 0, 0);
+    // Compared with the history as it was, then added to it if a person
+    // played it on their own
+    if (hist) {
+        history_stats(hist, s, &hs);
+        if (!playback && !vs && !bot)
+            history_add(hist, s, seed);
+    }
 
-    usleep(500000);
-    mvprintw(offset_y + 11, offset_x + 53, " GO! ");
-    refresh();
-    usleep(500000);
+    // Post game screen
+    if (s->done || ended) {
+        draw_board(&ss->board_win, &s->board, &s->curr, 21, 1);
+        draw_stats(&ss->stat_win, s->done ? s->end_time : s->time, s->pieces, s->keys, s->holds, hist ? &hs : NULL);
+        draw_finesse(&ss->fin_win, s->faults, s->fault, s->last_keys, &s->finesse);
+        // Nothing moves here, so only wake up for input. Keys never get a
+        // release in NORM mode, so poll at the frame rate to clear them
+        struct pollfd pfd = { .fd = poll_fd, .events = POLLIN };
+        int idle_timeout = config->mode == NORM ? 1000 / FPS : -1;
+        while (1) {
+            get_inputs(config, *fd, &inputs, &events);
+            if (inputs.actions & (1 << RESET | 1 << QUIT))
+                break;
+            draw_keys(&ss->key_win, inputs.actions);
+            draw_flush();
+            poll(&pfd, 1, idle_timeout);
+        }
+    }
 
-    time_t start_time = get_ms();
-    time_t game_time;
+    return playback ? 1 : (inputs.actions >> QUIT) & 1;
+}
 
-    queue_pos = queue_pop(curr, queue, 0);
+// Runs a replay through the core unthrottled and checks it reproduces the
+// recorded result
+static int verify_replay(Replay *r, const char *path) {
+    GameState s;
+    uint64_t start = get_ns();
+    int ok = replay_run(r, &s);
+    uint64_t elapsed = get_ns() - start;
+
+    uint64_t time = s.done ? s.end_time : s.time;
+    printf("%s: %s, %d pieces, %d lines in %d.%03ds, %.2f KPP, replayed in %.3fms\n",
+        path, ok ? "verified" : "MISMATCH", s.pieces, s.cleared,
+        (int) (time / NS_PER_SEC), (int) (time / NS_PER_MS % 1000),
+        s.pieces ? (double) s.keys / s.pieces : 0.0, (double) elapsed / NS_PER_MS);
+    return ok;
+}
 
-    // Game Loop
-    while (1) {
-        game_time = get_ms();
-        for (int8_t i = 0; i < KEYS; i++)
-            last_inputs[i] = inputs[i];
-        get_inputs(config, fd, inputs);
-
-        for (int8_t i = 0; i < 8; i++) {
-            keys_tmp += inputs[i] && !last_inputs[i];
+int main(int argc, char **argv) {
+    char *replay_path = NULL;
+    char *versus_path = NULL;
+    char *spectate_name = NULL;
+    int8_t fast = 0;
+    int8_t use_bot = 0;
+    int8_t use_ansi = 0;
+    int8_t use_evdev = 0;
+    int8_t startup_trace = 0;
+    launch = get_ns();
+    Perf perf;
+    perf_init(&perf);
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (!strcmp(argv[i], "--fast"))
+            fast = 1;
+        else if (!strcmp(argv[i], "--bot"))
+            use_bot = 1;
+        else if (!strcmp(argv[i], "--perf"))
+            perf.overlay = 1;
+        else if (!strcmp(argv[i], "--ansi"))
+            use_ansi = 1;
+        else if (!strcmp(argv[i], "--evdev"))
+            use_evdev = 1;
+        else if (!strcmp(argv[i], "--versus") && i + 1 < argc)
+            versus_path = argv[++i];
+        else if (!strcmp(argv[i], "--spectate") && i + 1 < argc)
+            spectate_name = argv[++i];
+        else if (!strcmp(argv[i], "--startup-trace"))
+            startup_trace = 1;
+        else {
+            fprintf(stderr, "Usage: %s [--bot] [--perf] [--ansi] [--evdev] [--versus SOCKET] [--spectate NAME] [--startup-trace] [--replay FILE [--fast]]\n", argv[0]);
+            return 1;
         }
+    }
 
-        if (inputs[RESET] || inputs[QUIT])
-            break;
-        if (inputs[HD] && !last_inputs[HD]) {
-            move_piece(board, curr, 0, -curr->y);
-            lock_piece(board, curr);
-            queue_pos = queue_pop(curr, queue, queue_pos);
-            cleared += clear_lines(board);
-            hold_used = 0;
-            grav_c = 0;
-            pieces++;
-            keys += keys_tmp;
-            keys_tmp = 0;
-            if (cleared >= CLEAR_GOAL)
-                break;
+    Replay replay;
+    if (replay_path) {
+        if (replay_load(&replay, replay_path)) {
+            fprintf(stderr, "Could not read replay %s\n", replay_path);
+            return 1;
         }
-
-        if (inputs[LEFT] && rdas_c != DAS - 1) {
-            ldas_c++;
-        } else if (!inputs[LEFT] && ldas_c)
-            ldas_c = 0;
-
-        if (inputs[RIGHT] && ldas_c != DAS - 1) {
-            rdas_c++;
-        } else if (!inputs[RIGHT] && rdas_c)
-            rdas_c = 0;
-
-        if (ldas_c > DAS && (rdas_c == 0 || rdas_c > ldas_c))
-            move_piece(board, curr, 1, -BOARD_WIDTH);
-        if (rdas_c > DAS && (ldas_c == 0 || ldas_c > rdas_c))
-            move_piece(board, curr, 1, BOARD_WIDTH);
-
-        if (inputs[LEFT] && !last_inputs[LEFT])
-            move_piece(board, curr, 1, -1);
-        if (inputs[RIGHT] && !last_inputs[RIGHT])
-            move_piece(board, curr, 1, 1);
-
-        if (inputs[SD])
-            move_piece(board, curr, 0, -curr->y);
-        if (inputs[CCW] && !last_inputs[CCW])
-            spin_piece(board, curr, 2);
-        if (inputs[CW] && !last_inputs[CW])
-            spin_piece(board, curr, 0);
-        if (inputs[FLIP] && !last_inputs[FLIP])
-            spin_piece(board, curr, 1);
-        if (inputs[HOLD] && !last_inputs[HOLD]) {
-            if (hold == -1) {
-                hold = curr->type;
-                queue_pos = queue_pop(curr, queue, queue_pos);
-                holds++;
-            } else if (!hold_used) {
-                int8_t tmp = hold;
-                hold = curr->type;
-                gen_piece(curr, tmp);
-                holds++;
-            }
-            hold_used = 1;
-            grav_c = 0;
+        if (fast) {
+            int ok = verify_replay(&replay, replay_path);
+            replay_free(&replay);
+            return !ok;
         }
-
-        // Updates
-        draw_board(board_win, board, curr, CLEAR_GOAL - cleared, 0);
-        draw_queue(queue_win, queue, queue_pos);
-        draw_hold(hold_win, hold, hold_used);
-        draw_keys(key_win, inputs);
-        draw_stats(stat_win, game_time - start_time, pieces, keys, holds);
-
-        // Gravity Movement
-        grav_c += grav;
-        move_piece(board, curr, 0, (int) -grav_c);
-        grav_c = grav_c - (int) grav_c;
-
-        usleep(1000000 / FPS - (get_ms() - game_time));
     }
 
-    // Post game screen
-    if (cleared >= CLEAR_GOAL) {
-        draw_board(board_win, board, curr, 21, 1);
-        draw_stats(stat_win, game_time - start_time, pieces, keys, holds);
-        while (1) {
-            get_inputs(config, fd, inputs);
-            if (inputs[RESET] || inputs[QUIT])
-                break;
-            draw_keys(key_win, inputs);
-            usleep(1000000 / FPS);
+    Versus versus;
+    Versus *vs = NULL;
+    if (versus_path && !replay_path) {
+        if (versus_open(&versus, versus_path)) {
+            fprintf(stderr, "Could not open versus socket %s: %s\n", versus_path, strerror(errno));
+            return 1;
         }
+        vs = &versus;
     }
 
-    free(curr);
-    delwin(board_win);
-    delwin(queue_win);
-    delwin(hold_win);
-    delwin(key_win);
-    clear();
-
-    return inputs[QUIT];
-}
+    Spectate spectate;
+    Spectate *sp = NULL;
+    if (spectate_name) {
+        if (spectate_open(&spectate, spectate_name)) {
+            if (errno == EEXIST)
+                fprintf(stderr, "Shared memory %s is in use by another game\n", spectate_name);
+            else
+                fprintf(stderr, "Could not create shared memory %s: %s\n", spectate_name, strerror(errno));
+            if (vs)
+                versus_close(vs);
+            if (replay_path)
+                replay_free(&replay);
+            return 1;
+        }
+        sp = &spectate;
+    }
 
-int main() {
-    srandom(time(NULL));
     setlocale(LC_ALL, "");
 
     struct termios old;
     struct termios new;
     int fd = -1;
     Config config = { 0 };
-    config.mode = EXTKEYS;
+    config.mode = use_evdev ? EVDEV : EXTKEYS;
 
     init_curses();
+    startup_mark(T_CURSES);
 
     config.mode = mode_set(config.mode, &old, &new, &fd);
+    startup_mark(T_INPUT);
     config_init(&config);
+    startup_mark(T_CONFIG);
+    // Changes to the file apply from the next game
+    ConfigWatch watch;
+    config_watch(&watch, &config);
+
+    // curses still sets up the terminal and reads keys, the ANSI renderer
+    // only takes over output
+    AnsiScreen ansi;
+    if (use_ansi && !ansi_init(&ansi, STDOUT_FILENO, LINES, COLS))
+        draw_use_ansi(&ansi);
+    else
+        use_ansi = 0;
 
     // Main loop
     int8_t status = 0;
-    while (!(status = game(&config, fd)));
+    Session session;
+    session_init(&session, &config);
+    Bot bot;
+    PcSolver solver;
+    PcSolver *pc = pc_init(&solver) ? NULL : &solver;
+    // Games are still played without a history, just not compared
+    char history_path[4096];
+    History history;
+    History *hist = NULL;
+    if (!history_dir(history_path, sizeof(history_path)) && !history_open(&history, history_path))
+        hist = &history;
+    startup_mark(T_SETUP);
+    if (replay_path) {
+        replay_config(&replay, &config);
+        status = game(&session, &config, &fd, &replay, NULL, pc, &perf, NULL, sp, hist);
+        replay_free(&replay);
+    } else if (use_bot && !bot_init(&bot, &config)) {
+        while (!(status = game(&session, &config, &fd, NULL, &bot, pc, &perf, vs, sp, hist))) {
+            // The bot takes its settings once, so it is rebuilt with them
+            if (config_reload(&watch, &config)) {
+                bot_free(&bot);
+                if (bot_init(&bot, &config)) {
+                    use_bot = 0;
+                    break;
+                }
+            }
+        }
+        if (use_bot)
+            bot_free(&bot);
+    } else {
+        while (!(status = game(&session, &config, &fd, NULL, NULL, pc, &perf, vs, sp, hist)))
+            config_reload(&watch, &config);
+    }
+    config_unwatch(&watch);
+    if (vs)
+        versus_close(vs);
+    if (sp)
+        spectate_close(sp);
+    if (pc)
+        pc_free(pc);
+    if (hist)
+        history_close(hist);
+    session_free(&session);
 
     // Cleanup 
+    if (use_ansi) {
+        draw_use_ansi(NULL);
+        ansi_free(&ansi);
+    }
     input_clean(config.mode, &old, fd);
 
     endwin();
 
     if (status == 2) {
-        fprintf(stderr, "Screen dimensions smaller than %dx%d\n", WIDTH, HEIGHT);
+        fprintf(stderr, "Screen dimensions smaller than %dx%d\n", vs ? VERSUS_WIDTH : WIDTH, HEIGHT);
     }
 
+    if (startup_trace)
+        write_startup(stderr, &config);
+
+    char perf_file[4096];
+    if (perf.frames && !perf_path(perf_file, sizeof(perf_file)))
+        perf_write(&perf, perf_file);
+
     return 0;
 }
@@ -0,0 +1,374 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pc.h"
+#include "finesse.h"
+#include "search.h"
+
+// Boards are PC_MAX_HEIGHT rows packed into one word, bit y * 10 + x
+#define ROWS_MASK(h) ((1ULL << (BOARD_WIDTH * (h))) - 1)
+#define LEFT_COL 0x0004010040100401ULL
+#define RIGHT_COL (LEFT_COL << (BOARD_WIDTH - 1))
+#define MAX_LANDINGS 128
+// Index of T in pieces, the only piece that breaks checkerboard parity
+#define T_PIECE 5
+
+typedef struct Ctx {
+    PcSolver *pc;
+    uint32_t id;
+    int8_t seq[PC_PREVIEW + 1];
+    uint64_t nodes;
+    int8_t aborted;
+    int8_t len;
+
+    // Steps on the current path, cells in the rows of the request
+    int8_t type[PC_MAX_PIECES];
+    int8_t held[PC_MAX_PIECES];
+    uint64_t cells[PC_MAX_PIECES];
+} Ctx;
+
+void pc_input(PcInput *in, GameState *s) {
+    memcpy(in->rows, s->board.rows, sizeof(in->rows));
+    in->too_high = 0;
+    for (int8_t y = PC_MAX_HEIGHT; y < ARR_HEIGHT; y++)
+        in->too_high |= s->board.rows[y] != 0;
+    in->curr = s->curr.type;
+    in->hold = s->hold;
+    in->hold_used = s->hold_used;
+    for (int8_t i = 0; i < PC_PREVIEW; i++)
+        in->preview[i] = s->queue[(s->queue_pos + i) % BAG_SZ];
+}
+
+// Distinct resting places of a piece brought in at spawn height: dropped
+// from every rotation and column it can reach up there, then shifted or spun
+// along the stack and dropped again. Only valid below finesse_clear_row
+static int landings(Board *board, int8_t type, Piece out[MAX_LANDINGS]) {
+    uint8_t visited[4 * ARR_HEIGHT * BOARD_WIDTH / 8] = { 0 };
+    static const int8_t moves[] = { LEFT, RIGHT, CW, CCW, FLIP };
+    Piece queue[4 * ARR_HEIGHT * BOARD_WIDTH];
+    int n_queue = 0;
+    int n = 0;
+
+    for (int8_t rot = 0; rot < 4; rot++) {
+        for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+            const FinesseMove *m = &finesse_moves[type][rot][x];
+            if (m->len < 0)
+                continue;
+            Piece p = { .x = x, .y = m->y, .type = type, .rot = rot };
+            move_piece(board, &p, 0, -p.y);
+            int16_t index = SEARCH_INDEX(p.x, p.y, p.rot);
+            if (visited[index / 8] & (1 << index % 8))
+                continue;
+            visited[index / 8] |= 1 << index % 8;
+            queue[n_queue++] = p;
+        }
+    }
+
+    for (int head = 0; head < n_queue; head++) {
+        Piece p = queue[head];
+
+        uint64_t cells = search_cells(&p);
+        int8_t dup = 0;
+        for (int i = 0; i < n && !dup; i++)
+            dup = search_cells(&out[i]) == cells;
+        if (!dup && n < MAX_LANDINGS)
+            out[n++] = p;
+
+        for (int8_t k = 0; k < (int8_t) sizeof(moves); k++) {
+            Piece next = p;
+            search_press(board, &next, moves[k]);
+            move_piece(board, &next, 0, -next.y);
+            int16_t to = SEARCH_INDEX(next.x, next.y, next.rot);
+            if (visited[to / 8] & (1 << to % 8))
+                continue;
+            visited[to / 8] |= 1 << to % 8;
+            queue[n_queue++] = next;
+        }
+    }
+    return n;
+}
+
+static uint64_t grow(uint64_t region, uint64_t empty) {
+    uint64_t prev;
+    do {
+        prev = region;
+        region |= ((region & ~RIGHT_COL) << 1
+                 | (region & ~LEFT_COL) >> 1
+                 | region << BOARD_WIDTH
+                 | region >> BOARD_WIDTH) & empty;
+    } while (region != prev);
+    return region;
+}
+
+// Whether the empty cells could still be filled by the pieces to come:
+// every enclosed region needs a multiple of four cells, and on a checkerboard
+// only T pieces cover more of one colour than the other, two more at a time
+static int viable(Ctx *c, uint64_t board, int8_t h, int8_t curr, int8_t hold, int8_t next) {
+    uint64_t empty = ~board & ROWS_MASK(h);
+    int k = __builtin_popcountll(empty) / 4;
+
+    int8_t cand[PC_MAX_PIECES];
+    int n = 0;
+    if (curr >= 0)
+        cand[n++] = curr;
+    if (hold >= 0)
+        cand[n++] = hold;
+    for (int8_t i = next; i < PC_PREVIEW + 1; i++)
+        cand[n++] = c->seq[i];
+    if (k > n)
+        return 0;
+    if (n > k + 1)
+        n = k + 1;
+
+    for (uint64_t left = empty; left; ) {
+        uint64_t region = grow(left & -left, left);
+        if (__builtin_popcountll(region) % 4)
+            return 0;
+        left &= ~region;
+    }
+
+    uint64_t black = 0;
+    for (int8_t y = 0; y < h; y++)
+        black |= (y % 2 ? 0x2aaULL : 0x155ULL) << (y * BOARD_WIDTH);
+    int diff = abs(__builtin_popcountll(empty & black) - __builtin_popcountll(empty & ~black)) / 2;
+
+    int ts = 0;
+    for (int i = 0; i < n; i++)
+        ts += cand[i] == T_PIECE;
+    int tmax = ts < k ? ts : k;
+    int tmin = ts - (n - k) > 0 ? ts - (n - k) : 0;
+    for (int t = tmin; t <= tmax; t++)
+        if (t >= diff && (t - diff) % 2 == 0)
+            return 1;
+    return 0;
+}
+
+// Records a board that has no solution, returns 1 if it was already known
+static int seen(PcSolver *pc, uint64_t key, int8_t insert) {
+    uint32_t slot = (key * 0x9e3779b97f4a7c15ULL) >> 48;
+    for (int i = 0; i < 8; i++) {
+        PcEntry *e = &pc->table[(slot + i) % PC_TABLE_SZ];
+        if (e->gen == pc->gen && e->key == key)
+            return 1;
+        if (insert && e->gen != pc->gen) {
+            e->gen = pc->gen;
+            e->key = key;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+static int dfs(Ctx *c, uint64_t board, int8_t h, int8_t *map,
+               int8_t curr, int8_t hold, int8_t next, int8_t can_hold, int8_t depth) {
+    if (!h) {
+        c->len = depth;
+        return 1;
+    }
+    if (curr < 0 || c->aborted)
+        return 0;
+    if (++c->nodes > PC_MAX_NODES
+      || (!(c->nodes & 255) && __atomic_load_n(&c->pc->request, __ATOMIC_RELAXED) != c->id)) {
+        c->aborted = 1;
+        return 0;
+    }
+
+    uint64_t key = board
+                 | (uint64_t) h << 40
+                 | (uint64_t) (curr + 1) << 43
+                 | (uint64_t) (hold + 1) << 46
+                 | (uint64_t) next << 49
+                 | (uint64_t) can_hold << 52;
+    if (seen(c->pc, key, 0))
+        return 0;
+
+    Board b;
+    memset(b.rows, 0, sizeof(b.rows));
+    for (int8_t y = 0; y < h; y++)
+        b.rows[y] = (board >> (y * BOARD_WIDTH)) & FULL_ROW;
+
+    for (int8_t use_hold = 0; use_hold < 2; use_hold++) {
+        int8_t type = curr;
+        int8_t new_hold = hold;
+        int8_t new_next = next;
+        if (use_hold) {
+            if (!can_hold || hold == curr)
+                break;
+            if (hold < 0) {
+                if (next > PC_PREVIEW)
+                    break;
+                type = c->seq[new_next++];
+            } else {
+                type = hold;
+            }
+            new_hold = curr;
+        }
+        int8_t new_curr = new_next <= PC_PREVIEW ? c->seq[new_next] : -1;
+
+        Piece out[MAX_LANDINGS];
+        int n = landings(&b, type, out);
+        for (int i = 0; i < n; i++) {
+            uint64_t cells = 0;
+            uint64_t original = 0;
+            int8_t fits = 1;
+            for (int8_t j = 0; j < 4 && fits; j++) {
+                int8_t x = out[i].coords[j][0];
+                int8_t y = out[i].coords[j][1];
+                fits = y < h;
+                cells |= 1ULL << (y * BOARD_WIDTH + x) % 64;
+                original |= 1ULL << (map[y % h] * BOARD_WIDTH + x);
+            }
+            if (!fits)
+                continue;
+
+            // Drop full rows and remember where the rest came from
+            uint64_t filled = board | cells;
+            uint64_t rest = 0;
+            int8_t rest_map[PC_MAX_HEIGHT];
+            int8_t rest_h = 0;
+            for (int8_t y = 0; y < h; y++) {
+                uint64_t row = (filled >> (y * BOARD_WIDTH)) & FULL_ROW;
+                if (row == FULL_ROW)
+                    continue;
+                rest |= row << (rest_h * BOARD_WIDTH);
+                rest_map[rest_h++] = map[y];
+            }
+
+            if (rest_h && !viable(c, rest, rest_h, new_curr, new_hold, new_next + 1))
+                continue;
+
+            c->type[depth] = type;
+            c->held[depth] = use_hold;
+            c->cells[depth] = original;
+            if (dfs(c, rest, rest_h, rest_map, new_curr, new_hold, new_next + 1, 1, depth + 1))
+                return 1;
+        }
+    }
+
+    if (!c->aborted)
+        seen(c->pc, key, 1);
+    return 0;
+}
+
+void pc_solve(PcSolver *pc, PcInput *in, PcResult *out) {
+    Ctx c = { .pc = pc, .id = out->id };
+    c.seq[0] = in->curr;
+    memcpy(c.seq + 1, in->preview, PC_PREVIEW);
+    pc->gen++;
+
+    out->status = PC_NONE;
+    out->n = 0;
+    out->height = 0;
+
+    uint64_t board = 0;
+    int8_t top = 0;
+    for (int8_t y = 0; y < PC_MAX_HEIGHT; y++) {
+        board |= (uint64_t) in->rows[y] << (y * BOARD_WIDTH);
+        if (in->rows[y])
+            top = y + 1;
+    }
+
+    // Lowest clear first
+    int8_t map[PC_MAX_HEIGHT] = { 0, 1, 2, 3 };
+    for (int8_t h = top ? top : 1; !in->too_high && h <= PC_MAX_HEIGHT && !c.aborted; h++) {
+        if (!viable(&c, board, h, in->curr, in->hold, 1))
+            continue;
+        if (!dfs(&c, board, h, map, in->curr, in->hold, 1, !in->hold_used, 0))
+            continue;
+
+        out->status = PC_FOUND;
+        out->height = h;
+        for (int8_t y = 0; y < PC_MAX_HEIGHT; y++)
+            for (int8_t x = 0; x < BOARD_WIDTH; x++)
+                out->grid[y][x] = (in->rows[y] >> x) & 1 ? -1 : 0;
+        out->n = c.len;
+        for (int8_t i = 0; i < c.len; i++) {
+            out->type[i] = c.type[i];
+            out->held[i] = c.held[i];
+            for (int8_t bit = 0; bit < BOARD_WIDTH * PC_MAX_HEIGHT; bit++)
+                if (c.cells[i] >> bit & 1)
+                    out->grid[bit / BOARD_WIDTH][bit % BOARD_WIDTH] = i + 1;
+        }
+        break;
+    }
+    if (out->status == PC_NONE && c.aborted)
+        out->status = PC_GAVE_UP;
+    out->nodes = c.nodes;
+}
+
+static void *pc_main(void *arg) {
+    PcSolver *pc = arg;
+    pthread_mutex_lock(&pc->lock);
+    while (1) {
+        while (!pc->quit && !pc->pending)
+            pthread_cond_wait(&pc->wake, &pc->lock);
+        if (pc->quit)
+            break;
+        PcInput in = pc->input;
+        PcResult res = { .id = pc->request };
+        pc->pending = 0;
+        pthread_mutex_unlock(&pc->lock);
+
+        pc_solve(pc, &in, &res);
+
+        pthread_mutex_lock(&pc->lock);
+        if (res.id == pc->request) {
+            pc->result = res;
+            pc->ready = 1;
+        }
+    }
+    pthread_mutex_unlock(&pc->lock);
+    return NULL;
+}
+
+int pc_init(PcSolver *pc) {
+    memset(pc, 0, sizeof(*pc));
+    pc->table = calloc(PC_TABLE_SZ, sizeof(PcEntry));
+    if (!pc->table)
+        return -1;
+    pthread_mutex_init(&pc->lock, NULL);
+    pthread_cond_init(&pc->wake, NULL);
+    if (pthread_create(&pc->thread, NULL, pc_main, pc)) {
+        pc_free(pc);
+        return -1;
+    }
+    pc->started = 1;
+    return 0;
+}
+
+void pc_free(PcSolver *pc) {
+    if (pc->started) {
+        pthread_mutex_lock(&pc->lock);
+        pc->quit = 1;
+        pthread_cond_signal(&pc->wake);
+        pthread_mutex_unlock(&pc->lock);
+        pthread_join(pc->thread, NULL);
+    }
+    if (pc->table) {
+        pthread_mutex_destroy(&pc->lock);
+        pthread_cond_destroy(&pc->wake);
+    }
+    free(pc->table);
+    memset(pc, 0, sizeof(*pc));
+}
+
+uint32_t pc_request(PcSolver *pc, GameState *s) {
+    pthread_mutex_lock(&pc->lock);
+    pc_input(&pc->input, s);
+    pc->pending = 1;
+    pc->ready = 0;
+    uint32_t id = __atomic_add_fetch(&pc->request, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&pc->wake);
+    pthread_mutex_unlock(&pc->lock);
+    return id;
+}
+
+int pc_poll(PcSolver *pc, PcResult *out) {
+    pthread_mutex_lock(&pc->lock);
+    int ready = pc->ready;
+    if (ready) {
+        *out = pc->result;
+        pc->ready = 0;
+    }
+    pthread_mutex_unlock(&pc->lock);
+    return ready;
+}
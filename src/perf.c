@@ -0,0 +1,114 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "perf.h"
+#include "timing.h"
+
+static int bucket(uint64_t ns) {
+    if (ns < HIST_SUB)
+        return ns;
+    int e = 63 - __builtin_clzll(ns);
+    if (e >= HIST_OCTAVES)
+        return HIST_BUCKETS - 1;
+    return (e - 3) * HIST_SUB + ((ns >> (e - 4)) & (HIST_SUB - 1));
+}
+
+static uint64_t bucket_low(int b) {
+    if (b < HIST_SUB)
+        return b;
+    int e = b / HIST_SUB + 3;
+    return (uint64_t) (HIST_SUB + b % HIST_SUB) << (e - 4);
+}
+
+void hist_add(Hist *h, uint64_t ns) {
+    h->counts[bucket(ns)]++;
+    h->n++;
+    h->sum += ns;
+    if (ns > h->max)
+        h->max = ns;
+}
+
+uint64_t hist_percentile(Hist *h, double p) {
+    if (!h->n)
+        return 0;
+    uint64_t want = p * h->n;
+    if (want >= h->n)
+        want = h->n - 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen > want) {
+            uint64_t high = b + 1 < HIST_BUCKETS ? bucket_low(b + 1) - 1 : h->max;
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+void perf_init(Perf *perf) {
+    memset(perf, 0, sizeof(*perf));
+}
+
+void perf_frame(Perf *perf, InputEvents *events, uint64_t read, uint64_t update, uint64_t render) {
+    for (int i = 0; i < events->n; i++)
+        hist_add(&perf->latency, render > events->ev[i].time ? render - events->ev[i].time : 0);
+    hist_add(&perf->draw, render - update);
+    hist_add(&perf->frame, render - read);
+    perf->frames++;
+}
+
+static void write_hist(FILE *f, const char *name, Hist *h) {
+    fprintf(f, "%s: %llu samples, mean %.3fms, p50 %.3fms, p90 %.3fms, p99 %.3fms, max %.3fms\n",
+        name, (unsigned long long) h->n,
+        h->n ? (double) h->sum / h->n / NS_PER_MS : 0.0,
+        (double) hist_percentile(h, 0.5) / NS_PER_MS,
+        (double) hist_percentile(h, 0.9) / NS_PER_MS,
+        (double) hist_percentile(h, 0.99) / NS_PER_MS,
+        (double) h->max / NS_PER_MS);
+    // One line per bucket, <lowest ns> <count>
+    for (int b = 0; b < HIST_BUCKETS; b++)
+        if (h->counts[b])
+            fprintf(f, "  %llu %u\n", (unsigned long long) bucket_low(b), h->counts[b]);
+}
+
+int perf_write(Perf *perf, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return -1;
+    fprintf(f, "%llu frames, %llu missed deadlines\n",
+        (unsigned long long) perf->frames, (unsigned long long) perf->missed);
+    write_hist(f, "latency", &perf->latency);
+    write_hist(f, "draw", &perf->draw);
+    write_hist(f, "frame", &perf->frame);
+    if (perf->garbage.n)
+        write_hist(f, "garbage", &perf->garbage);
+    return fclose(f) ? -1 : 0;
+}
+
+int perf_path(char *path, size_t len) {
+    char *state_env = getenv("XDG_STATE_HOME");
+    char *home_env = getenv("HOME");
+    int n;
+    if (state_env)
+        n = snprintf(path, len, "%s/tetty", state_env);
+    else if (home_env)
+        n = snprintf(path, len, "%s/.local/state/tetty", home_env);
+    else
+        return -1;
+    if (n < 0 || (size_t) n + 10 > len)
+        return -1;
+
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = 0;
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    if (mkdir(path, 0755) && errno != EEXIST)
+        return -1;
+    strcat(path, "/perf.txt");
+    return 0;
+}
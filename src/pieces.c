@@ -0,0 +1,185 @@
+#include "pieces.h"
+
+// TODO: figure out better way to store this
+// Defined by offset from the piece center
+// 7 pieces, 4 rotations, 3 coordinate pairs
+const int8_t pieces[BAG_SZ][4][4][2] = {
+    // I
+    {
+        {{-1, 0}, {0, 0}, {1, 0}, {2, 0}},
+        // []<>[][]
+        {{0, -1}, {0, 0}, {0, 1}, {0, 2}},
+        // []
+        // <>
+        // []
+        // []
+        {{-2, 0}, {-1, 0}, {0, 0}, {1, 0}},
+        // [][]<>[]
+        {{0, -2}, {0, -1}, {0, 0}, {0, 1}},
+        // []
+        // []
+        // <>
+        // []
+    },
+    // J
+    {
+        {{-1, -1}, {-1, 0}, {0, 0}, {1, 0}},
+         // []
+         // []<>[]
+        {{0, -1}, {1, -1}, {0, 0}, {0, 1}},
+         // [][]
+         // <>
+         // []
+        {{-1, 0}, {0, 0}, {1, 0}, {1, 1}},
+         // []<>[]
+         //     []
+        {{0, -1}, {0, 0}, {-1, 1}, {0, 1}},
+         //   []
+         //   <>
+         // [][]
+    },
+    // L
+    {
+        {{1, -1}, {-1, 0}, {0, 0}, {1, 0}},
+        //     []
+        // []<>[]
+        {{0, -1}, {0, 0}, {0, 1}, {1, 1}},
+        // []
+        // <>
+        // [][]
+        {{-1, 0}, {0, 0}, {1, 0}, {-1, 1}},
+        // []<>[]
+        // []
+        {{-1, -1}, {0, -1}, {0, 0}, {0, 1}},
+        // [][]
+        //   <>
+        //   []
+    },
+    // O
+    {
+        {{0, -1}, {1, -1}, {0, 0}, {1, 0}},
+        // [][]
+        // <>[]
+        {{0, 0}, {1, 0}, {0, 1}, {1, 1}},
+        // <>[]
+        // [][]
+        {{-1, 0}, {0, 0}, {-1, 1}, {0, 1}},
+        // []<>
+        // [][]
+        {{-1, -1}, {0, -1}, {-1, 0}, {0, 0}}
+        // [][]
+        // []<>
+    },
+    // S
+    {
+        {{0, -1}, {1, -1}, {-1, 0}, {0, 0}},
+        //   [][]
+        // []<>
+        {{0, -1}, {0, 0}, {1, 0}, {1, 1}},
+        // []
+        // <>[]
+        //   []
+        {{0, 0}, {1, 0}, {-1, 1}, {0, 1}},
+        //   <>[]
+        // [][]
+        {{-1, -1}, {-1, 0}, {0, 0}, {0, 1}}
+        // []
+        // []<>
+        //   []
+    },
+    // T
+    {
+        {{0, -1}, {-1, 0},{0, 0},  {1, 0}},
+        //   []
+        // []<>[]
+        {{0, -1}, {0, 0}, {1, 0}, {0, 1}},
+        // []
+        // <>[]
+        // []
+        {{-1, 0}, {0, 0}, {1, 0}, {0, 1}},
+        // []<>[]
+        //   []
+        {{0, -1}, {-1, 0}, {0, 0}, {0, 1}}
+        //   []
+        // []<>
+        //   []
+    },
+    // Z
+    {
+        {{-1, -1}, {0, -1}, {0, 0}, {1, 0}},
+        // [][]
+        //   <>[]
+        {{1, -1}, {0, 0}, {1, 0}, {0, 1}},
+        //   []
+        // <>[]
+        // []
+        {{-1, 0}, {0, 0}, {0, 1}, {1, 1}},
+        // []<>
+        //   [][]
+        {{0, -1}, {-1, 0}, {0, 0}, {-1, 1}}
+        //   []
+        // []<>
+        // []
+    },
+};
+
+// 3 offset 'classes', 4 rotation states, 5 x & y offsets
+const int8_t offsets[3][4][5][2] = {
+    // J, L, S, T, Z
+    {
+        // Spawn
+        {{ 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+        // CW
+        {{ 0, 0}, { 1, 0}, { 1,-1}, { 0, 2}, { 1, 2}},
+        // 180
+        {{ 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+        // CCW
+        {{ 0, 0}, {-1, 0}, {-1,-1}, { 0, 2}, {-1, 2}},
+    },
+    // I
+    {
+        // Spawn
+        {{ 0, 0}, {-1, 0}, { 2, 0}, {-1, 0}, { 2, 0}},
+        // CW
+        {{-1, 0}, { 0, 0}, { 0, 0}, { 0, 1}, { 0,-2}},
+        // 180
+        {{-1, 1}, { 1, 1}, {-2, 1}, { 1, 0}, {-2, 0}},
+        // CCW
+        {{ 0, 1}, { 0, 1}, { 0, 1}, { 0,-1}, { 0, 2}},
+    },
+    // O
+    {
+        // Spawn
+        {{ 0, 0}},
+        // CW
+        {{ 0,-1}},
+        // 180
+        {{-1,-1}},
+        // CCW
+        {{-1, 0}},
+    },
+};
+
+// 180 offset table
+const int8_t offsets2[2][4][2][2] = {
+    {
+        // Spawn
+        {{ 0, 0}, { 0, 1}},
+        // CW
+        {{ 0, 0}, { 1, 0}},
+        // 180
+        {{ 0, 0}, { 0, 0}},
+        // CCW
+        {{ 0, 0}, { 0, 0}}
+    },
+    {
+        // Spawn
+        {{ 1, 0}, { 1, 0}},
+        // CW
+        {{-1, 0}, { 0, 0}},
+        // 180
+        {{ 0, 1}, { 0, 0}},
+        // CCW
+        {{ 0, 1}, { 0, 1}},
+    }
+};
@@ -0,0 +1,303 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "replay.h"
+
+#define REPLAY_HEADER 28
+// Version 4 follows the header with the rules, then the gravity of each level
+#define REPLAY_RULES 5
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | (uint32_t) get_u16(p + 2) << 16;
+}
+
+void replay_init(Replay *r, Config *config, uint32_t seed) {
+    memset(r, 0, sizeof(*r));
+    // Plenty for a sprint, so recording never allocates mid-game
+    r->cap = 16384;
+    r->data = malloc(r->cap);
+    replay_restart(r, config, seed);
+}
+
+void replay_restart(Replay *r, Config *config, uint32_t seed) {
+    uint8_t *data = r->data;
+    size_t cap = r->cap;
+    *r = (Replay) {
+        .seed = seed,
+        .das = config->das,
+        .arr = config->arr,
+        .sdf = config->sdf,
+        .lock = config->lock,
+        .lock_resets = config->lock_resets < 255 ? config->lock_resets : 255,
+        .level = config->level < 255 ? config->level : 255,
+        .levels = config->levels,
+        .data = data,
+        .cap = cap,
+    };
+    memcpy(r->gravity, config->gravity, sizeof(r->gravity));
+}
+
+void replay_free(Replay *r) {
+    free(r->data);
+    r->data = NULL;
+    r->len = r->cap = 0;
+}
+
+void replay_record(Replay *r, uint64_t time, uint8_t mask) {
+    if (mask == r->mask || !r->data)
+        return;
+
+    if (r->len + 11 > r->cap) {
+        uint8_t *data = realloc(r->data, r->cap * 2);
+        if (!data)
+            return;
+        r->data = data;
+        r->cap *= 2;
+    }
+
+    uint64_t us = time / CORE_RES;
+    uint64_t delta = us - r->last_time;
+    r->last_time = us;
+    r->mask = mask;
+
+    while (delta >= 0x80) {
+        r->data[r->len++] = (delta & 0x7f) | 0x80;
+        delta >>= 7;
+    }
+    r->data[r->len++] = delta;
+    r->data[r->len++] = mask;
+}
+
+void replay_finish(Replay *r, GameState *s) {
+    r->finished = s->done;
+    r->time_us = (s->done ? s->end_time : s->time) / CORE_RES;
+    r->pieces = s->pieces;
+    r->keys = s->keys;
+    r->holds = s->holds;
+    r->cleared = s->cleared;
+}
+
+int replay_save(Replay *r, const char *path) {
+    uint8_t header[REPLAY_HEADER];
+    memcpy(header, REPLAY_MAGIC, 4);
+    header[4] = REPLAY_VERSION;
+    header[5] = r->finished;
+    put_u32(header + 6, r->seed);
+    put_u16(header + 10, r->das);
+    put_u16(header + 12, r->arr);
+    put_u16(header + 14, r->sdf);
+    put_u32(header + 16, r->time_us);
+    put_u16(header + 20, r->pieces);
+    put_u16(header + 22, r->keys);
+    put_u16(header + 24, r->holds);
+    header[26] = r->cleared;
+    header[27] = 0;
+
+    uint8_t rules[REPLAY_RULES + LEVELS * 4];
+    put_u16(rules, r->lock);
+    rules[2] = r->lock_resets;
+    rules[3] = r->level;
+    rules[4] = r->levels;
+    for (int i = 0; i < r->levels; i++)
+        put_u32(rules + REPLAY_RULES + i * 4, r->gravity[i]);
+    size_t rules_len = REPLAY_RULES + r->levels * 4;
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -1;
+    int ok = fwrite(header, 1, sizeof(header), f) == sizeof(header)
+          && fwrite(rules, 1, rules_len, f) == rules_len
+          && fwrite(r->data, 1, r->len, f) == r->len;
+    return (fclose(f) == 0 && ok) ? 0 : -1;
+}
+
+int replay_load(Replay *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return -1;
+
+    uint8_t header[REPLAY_HEADER];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header)
+      || memcmp(header, REPLAY_MAGIC, 4)
+      || header[4] < 3 || header[4] > REPLAY_VERSION) {
+        fclose(f);
+        return -1;
+    }
+    r->finished = header[5];
+    r->seed = get_u32(header + 6);
+    r->das = get_u16(header + 10);
+    r->arr = get_u16(header + 12);
+    r->sdf = get_u16(header + 14);
+    r->time_us = get_u32(header + 16);
+    r->pieces = get_u16(header + 20);
+    r->keys = get_u16(header + 22);
+    r->holds = get_u16(header + 24);
+    r->cleared = header[26];
+
+    uint8_t rules[REPLAY_RULES + LEVELS * 4];
+    if (header[4] > 3) {
+        if (fread(rules, 1, REPLAY_RULES, f) != REPLAY_RULES
+          || rules[4] > LEVELS
+          || fread(rules + REPLAY_RULES, 4, rules[4], f) != rules[4]) {
+            fclose(f);
+            return -1;
+        }
+        r->lock = get_u16(rules);
+        r->lock_resets = rules[2];
+        r->level = rules[3];
+        r->levels = rules[4];
+        for (int i = 0; i < r->levels; i++)
+            r->gravity[i] = get_u32(rules + REPLAY_RULES + i * 4);
+    }
+
+    r->cap = 4096;
+    r->data = malloc(r->cap);
+    size_t n;
+    while (r->data && (n = fread(r->data + r->len, 1, r->cap - r->len, f)) > 0) {
+        r->len += n;
+        if (r->len == r->cap) {
+            uint8_t *data = realloc(r->data, r->cap * 2);
+            if (!data)
+                break;
+            r->data = data;
+            r->cap *= 2;
+        }
+    }
+    fclose(f);
+    if (!r->data)
+        return -1;
+    replay_rewind(r);
+    return 0;
+}
+
+void replay_config(Replay *r, Config *config) {
+    config->das = r->das;
+    config->arr = r->arr;
+    config->sdf = r->sdf;
+    config->lock = r->lock;
+    config->lock_resets = r->lock_resets;
+    config->level = r->level;
+    config->levels = r->levels;
+    memcpy(config->gravity, r->gravity, sizeof(config->gravity));
+}
+
+void replay_rewind(Replay *r) {
+    r->pos = 0;
+    r->last_time = 0;
+    r->mask = 0;
+}
+
+// Decodes the delta at pos without consuming it
+static int decode(Replay *r, uint64_t *time, size_t *end) {
+    uint64_t delta = 0;
+    size_t pos = r->pos;
+    for (int shift = 0; pos < r->len; shift += 7) {
+        uint8_t b = r->data[pos++];
+        delta |= (uint64_t) (b & 0x7f) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    if (pos >= r->len)
+        return 0;
+    *time = r->last_time + delta;
+    *end = pos;
+    return 1;
+}
+
+int replay_peek(Replay *r, uint64_t *time) {
+    size_t end;
+    uint64_t us;
+    if (!decode(r, &us, &end))
+        return 0;
+    *time = us * CORE_RES;
+    return 1;
+}
+
+int replay_next(Replay *r, uint64_t *time, uint8_t *mask) {
+    size_t end;
+    uint64_t us;
+    if (!decode(r, &us, &end))
+        return 0;
+    r->last_time = us;
+    *time = us * CORE_RES;
+    *mask = r->data[end];
+    r->pos = end + 1;
+    return 1;
+}
+
+void replay_apply(GameState *s, uint8_t old_mask, uint8_t mask, uint64_t time) {
+    uint8_t changed = old_mask ^ mask;
+    for (int8_t i = 0; i < HOLD + 1; i++)
+        if (changed & (1 << i))
+            core_input(s, i, (mask >> i) & 1, time);
+}
+
+int replay_run(Replay *r, GameState *s) {
+    Config config = { 0 };
+    replay_config(r, &config);
+    core_init(s, &config, r->seed);
+    core_start(s);
+
+    uint64_t time;
+    uint8_t mask;
+    uint8_t last = 0;
+    replay_rewind(r);
+    while (replay_next(r, &time, &mask)) {
+        replay_apply(s, last, mask, time);
+        last = mask;
+    }
+    if (!s->done)
+        core_advance(s, (uint64_t) r->time_us * CORE_RES);
+
+    return s->done == r->finished
+        && s->pieces == r->pieces
+        && s->keys == r->keys
+        && s->holds == r->holds
+        && s->cleared == r->cleared
+        && (!s->done || s->end_time / CORE_RES == r->time_us);
+}
+
+int replay_dir(char *path, size_t len) {
+    char *data_env = getenv("XDG_DATA_HOME");
+    char *home_env = getenv("HOME");
+    int n;
+    if (data_env)
+        n = snprintf(path, len, "%s/tetty", data_env);
+    else if (home_env)
+        n = snprintf(path, len, "%s/.local/share/tetty", home_env);
+    else
+        return -1;
+    if (n < 0 || (size_t) n + 9 > len)
+        return -1;
+
+    // Make each level, the data dir itself may not exist yet
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = 0;
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    mkdir(path, 0755);
+    strcat(path, "/replays");
+    if (mkdir(path, 0755) && errno != EEXIST)
+        return -1;
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <string.h>
+#include "search.h"
+
+// Keys tried from every state, in order of preference for equal cost paths
+static const int8_t search_keys[] = { LEFT, RIGHT, DAS_LEFT, DAS_RIGHT, CW, CCW, FLIP, SD };
+
+void search_press(Board *board, Piece *p, int8_t key) {
+    switch (key) {
+    case LEFT:
+        move_piece(board, p, 1, -1);
+        break;
+    case RIGHT:
+        move_piece(board, p, 1, 1);
+        break;
+    case DAS_LEFT:
+        move_piece(board, p, 1, -BOARD_WIDTH);
+        break;
+    case DAS_RIGHT:
+        move_piece(board, p, 1, BOARD_WIDTH);
+        break;
+    case CW:
+        spin_piece(board, p, 0);
+        break;
+    case FLIP:
+        spin_piece(board, p, 1);
+        break;
+    case CCW:
+        spin_piece(board, p, 2);
+        break;
+    case SD:
+        move_piece(board, p, 0, -p->y);
+        break;
+    }
+}
+
+void search_run(Search *s, Board *board, Piece *start, int8_t soft_drop) {
+    memset(s->nodes, -1, sizeof(s->nodes));
+    s->type = start->type;
+    s->n = 0;
+
+    int16_t first = SEARCH_INDEX(start->x, start->y, start->rot);
+    s->nodes[first].cost = 0;
+    s->order[s->n++] = first;
+
+    int8_t n_keys = sizeof(search_keys) - !soft_drop;
+    for (int head = 0; head < s->n; head++) {
+        int16_t from = s->order[head];
+        Piece p;
+        search_piece(s, from, &p);
+
+        for (int8_t k = 0; k < n_keys; k++) {
+            Piece next = p;
+            search_press(board, &next, search_keys[k]);
+            if ((uint8_t) next.y >= ARR_HEIGHT)
+                continue;
+            int16_t to = SEARCH_INDEX(next.x, next.y, next.rot);
+            if (s->nodes[to].cost >= 0)
+                continue;
+            s->nodes[to].cost = s->nodes[from].cost + 1;
+            s->nodes[to].key = search_keys[k];
+            s->nodes[to].parent = from;
+            s->order[s->n++] = to;
+        }
+    }
+}
+
+void search_piece(Search *s, int16_t index, Piece *p) {
+    p->type = s->type;
+    p->x = index % BOARD_WIDTH;
+    p->y = index / BOARD_WIDTH % ARR_HEIGHT;
+    p->rot = index / (BOARD_WIDTH * ARR_HEIGHT);
+    for (int8_t i = 0; i < 4; i++) {
+        p->coords[i][0] = p->x + pieces[p->type][p->rot][i][0];
+        p->coords[i][1] = p->y - pieces[p->type][p->rot][i][1];
+    }
+}
+
+int8_t search_path(Search *s, int16_t index, int8_t keys[SEARCH_MAX_PATH]) {
+    int8_t len = s->nodes[index].cost;
+    if (len < 0 || len > SEARCH_MAX_PATH)
+        return -1;
+    for (int8_t i = len - 1; i >= 0; i--) {
+        keys[i] = s->nodes[index].key;
+        index = s->nodes[index].parent;
+    }
+    return len;
+}
+
+uint64_t search_cells(Piece *p) {
+    int8_t bottom = p->coords[0][1];
+    for (int8_t i = 1; i < 4; i++)
+        if (p->coords[i][1] < bottom)
+            bottom = p->coords[i][1];
+
+    uint64_t cells = (uint64_t) bottom << 48;
+    for (int8_t i = 0; i < 4; i++)
+        cells |= 1ULL << ((p->coords[i][1] - bottom) * BOARD_WIDTH + p->coords[i][0]);
+    return cells;
+}
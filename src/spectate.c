@@ -0,0 +1,147 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "spectate.h"
+
+// A reader gives up on a frame after this many torn reads
+#define READ_TRIES 64
+
+// A segment whose game closed it, one still live or that isn't a spectator
+// segment at all belongs to someone else
+static int stale(const char *name) {
+    SpectateShm *shm = spectate_attach(name);
+    if (!shm)
+        return 0;
+    int live = __atomic_load_n(&shm->live, __ATOMIC_ACQUIRE);
+    spectate_detach(shm);
+    return !live;
+}
+
+int spectate_open(Spectate *sp, const char *name) {
+    memset(sp, 0, sizeof(*sp));
+    if (strlen(name) >= sizeof(sp->name))
+        return -1;
+    strcpy(sp->name, name);
+
+    // Never resized in place, viewers may still have an old one mapped
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        if (!stale(name)) {
+            errno = EEXIST;
+            return -1;
+        }
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd < 0)
+        return -1;
+    if (ftruncate(fd, sizeof(SpectateShm))) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    SpectateShm *shm = mmap(NULL, sizeof(SpectateShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+
+    shm->version = SPECTATE_VERSION;
+    shm->size = sizeof(SpectateFrame);
+    shm->live = 1;
+    // Readers check this last, after everything above is in place
+    __atomic_store_n(&shm->magic, SPECTATE_MAGIC, __ATOMIC_RELEASE);
+    sp->shm = shm;
+    return 0;
+}
+
+void spectate_close(Spectate *sp) {
+    if (!sp->shm)
+        return;
+    // Unlinked first, once live is clear another game may take the name
+    shm_unlink(sp->name);
+    __atomic_store_n(&sp->shm->live, 0, __ATOMIC_RELEASE);
+    munmap(sp->shm, sizeof(SpectateShm));
+    sp->shm = NULL;
+}
+
+void spectate_new_game(Spectate *sp) {
+    sp->game++;
+}
+
+void spectate_publish(Spectate *sp, GameState *s) {
+    SpectateFrame f;
+    f.time = s->done ? s->end_time : s->time;
+    f.frame = ++sp->published;
+    f.game = sp->game;
+    f.board_version = s->board.version;
+    memcpy(f.rows, s->board.rows, sizeof(f.rows));
+    memcpy(f.colors, s->board.colors, sizeof(f.colors));
+    f.x = s->curr.x;
+    f.y = s->curr.y;
+    f.type = s->curr.type;
+    f.rot = s->curr.rot;
+    f.hold = s->hold;
+    f.hold_used = s->hold_used;
+    for (int8_t i = 0; i < SPECTATE_QUEUE; i++)
+        f.queue[i] = s->queue[(s->queue_pos + i) % BAG_SZ];
+    f.done = s->done;
+    f.inputs = s->inputs;
+    f.pieces = s->pieces;
+    f.keys = s->keys;
+    f.holds = s->holds;
+    f.cleared = s->cleared;
+    f.faults = s->faults;
+
+    // Odd while the copy is in progress
+    SpectateShm *shm = sp->shm;
+    uint32_t seq = shm->seq;
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&shm->frame, &f, sizeof(f));
+    __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+SpectateShm *spectate_attach(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    // One being created may not have its size yet, and touching past the
+    // end would fault
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t) sizeof(SpectateShm)) {
+        close(fd);
+        return NULL;
+    }
+    SpectateShm *shm = mmap(NULL, sizeof(SpectateShm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED)
+        return NULL;
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != SPECTATE_MAGIC
+      || shm->version != SPECTATE_VERSION || shm->size != sizeof(SpectateFrame)) {
+        munmap(shm, sizeof(SpectateShm));
+        return NULL;
+    }
+    return shm;
+}
+
+void spectate_detach(SpectateShm *shm) {
+    munmap(shm, sizeof(SpectateShm));
+}
+
+int spectate_read(SpectateShm *shm, SpectateFrame *out) {
+    for (int i = 0; i < READ_TRIES; i++) {
+        uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        memcpy(out, &shm->frame, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq)
+            return 1;
+    }
+    return 0;
+}
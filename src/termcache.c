@@ -0,0 +1,120 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "termcache.h"
+
+// One line per terminal: tty TERM mode console, - for no console
+#define CACHE_LINE 512
+
+static const char *mode_names[MODES] = {
+    [EXTKEYS]   = "extkeys",
+    [SCANCODES] = "scan",
+    [NORM]      = "norm",
+    [EVDEV]     = "evdev",
+};
+
+static int cache_path(char *path, size_t len) {
+    char *cache_env = getenv("XDG_CACHE_HOME");
+    char *home_env = getenv("HOME");
+    int n;
+    if (cache_env)
+        n = snprintf(path, len, "%s/tetty", cache_env);
+    else if (home_env)
+        n = snprintf(path, len, "%s/.cache/tetty", home_env);
+    else
+        return -1;
+    if (n < 0 || (size_t) n + 16 > len)
+        return -1;
+
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = 0;
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    if (mkdir(path, 0755) && errno != EEXIST)
+        return -1;
+    strcat(path, "/terminals");
+    return 0;
+}
+
+// The first two fields of a line, for this terminal
+static int terminal_key(char *key, size_t len) {
+    char *tty = ttyname(STDIN_FILENO);
+    char *term = getenv("TERM");
+    if (!term || !*term)
+        term = "-";
+    // Fields are split on whitespace
+    if (!tty || strpbrk(tty, " \t\n") || strpbrk(term, " \t\n"))
+        return -1;
+    int n = snprintf(key, len, "%s %s ", tty, term);
+    return n < 0 || (size_t) n >= len ? -1 : 0;
+}
+
+int termcache_get(enum InputMode *mode, char *console, size_t len) {
+    char path[4096];
+    char key[CACHE_LINE];
+    if (cache_path(path, sizeof(path)) || terminal_key(key, sizeof(key)))
+        return -1;
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    char line[CACHE_LINE];
+    size_t key_len = strlen(key);
+    int found = -1;
+    while (found && fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, key_len))
+            continue;
+        char name[16];
+        char cons[CACHE_LINE];
+        if (sscanf(line + key_len, "%15s %511s", name, cons) != 2)
+            continue;
+        for (int m = 0; m < MODES; m++) {
+            if (strcmp(name, mode_names[m]))
+                continue;
+            *mode = m;
+            snprintf(console, len, "%s", strcmp(cons, "-") ? cons : "");
+            found = 0;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+int termcache_put(enum InputMode mode, const char *console) {
+    char path[4096];
+    char tmp[4096 + 8];
+    char key[CACHE_LINE];
+    if (cache_path(path, sizeof(path)) || terminal_key(key, sizeof(key)))
+        return -1;
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+
+    FILE *out = fopen(tmp, "w");
+    if (!out)
+        return -1;
+    // Newest first, then everything else that is still remembered
+    fprintf(out, "%s%s %s\n", key, mode_names[mode], console && *console ? console : "-");
+    FILE *in = fopen(path, "r");
+    char line[CACHE_LINE];
+    size_t key_len = strlen(key);
+    for (int n = 1; in && n < TERMCACHE_MAX && fgets(line, sizeof(line), in); ) {
+        if (strncmp(line, key, key_len) && strchr(line, '\n')) {
+            fputs(line, out);
+            n++;
+        }
+    }
+    if (in)
+        fclose(in);
+
+    // Renamed over the old file so a reader never sees half of it
+    if (fclose(out) || rename(tmp, path)) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
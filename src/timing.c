@@ -0,0 +1,70 @@
+#define _GNU_SOURCE
+#include <poll.h>
+#include <time.h>
+#include "timing.h"
+
+uint64_t get_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+void sched_init(Scheduler *s, uint64_t period) {
+    s->period = period;
+    s->deadline = get_ns() + period;
+    s->frames = 0;
+    s->late = 0;
+    s->dropped = 0;
+    s->worst_late = 0;
+}
+
+int sched_wait(Scheduler *s, int fd) {
+    return sched_wait_any(s, &fd, 1);
+}
+
+int sched_wait_any(Scheduler *s, const int *fds, int n) {
+    uint64_t now = get_ns();
+
+    // A frame is only late if it got here after its deadline, a poll that
+    // times out wakes a little past it and still counts as on time
+    if (now < s->deadline) {
+        struct pollfd pfds[SCHED_FDS];
+        int npfds = 0;
+        for (int i = 0; i < n && npfds < SCHED_FDS; i++)
+            if (fds[i] >= 0)
+                pfds[npfds++] = (struct pollfd) { .fd = fds[i], .events = POLLIN };
+        if (npfds) {
+            struct timespec ts = {
+                .tv_sec = (s->deadline - now) / NS_PER_SEC,
+                .tv_nsec = (s->deadline - now) % NS_PER_SEC
+            };
+            if (ppoll(pfds, npfds, &ts, NULL) > 0)
+                return 0;
+        }
+        // Returns at once if the poll already ran out
+        struct timespec ts = {
+            .tv_sec = s->deadline / NS_PER_SEC,
+            .tv_nsec = s->deadline % NS_PER_SEC
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL));
+        s->deadline += s->period;
+        s->frames++;
+        return 1;
+    }
+
+    uint64_t behind = now - s->deadline;
+    uint64_t ticks = behind / s->period + 1;
+    s->late++;
+    if (behind > s->worst_late)
+        s->worst_late = behind;
+
+    if (ticks > MAX_CATCHUP) {
+        s->dropped += ticks - MAX_CATCHUP;
+        ticks = MAX_CATCHUP;
+        s->deadline = now + s->period;
+    } else {
+        s->deadline += ticks * s->period;
+    }
+    s->frames += ticks;
+    return ticks;
+}
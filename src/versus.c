@@ -0,0 +1,225 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "core.h"
+#include "timing.h"
+#include "versus.h"
+
+int versus_open(Versus *v, const char *path) {
+    memset(v, 0, sizeof(*v));
+    v->listen_fd = -1;
+    v->fd = -1;
+    v->rng = get_ns();
+    // Never matches a real snapshot, so the first one always goes out
+    memset(&v->board, 0xff, sizeof(v->board));
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+    strcpy(v->path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (!connect(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        v->fd = fd;
+        v->peer.connected = 1;
+        MsgHello hello = { VERSUS_VERSION };
+        uint8_t buf[1 + sizeof(hello)] = { MSG_HELLO };
+        memcpy(buf + 1, &hello, sizeof(hello));
+        send(fd, buf, sizeof(buf), MSG_DONTWAIT | MSG_NOSIGNAL);
+        return 0;
+    }
+
+    // Nobody there, a socket left behind by a crashed instance is replaced
+    // but anything else at the path is left alone
+    struct stat st;
+    if (errno == ECONNREFUSED && !lstat(path, &st)) {
+        if (!S_ISSOCK(st.st_mode)) {
+            close(fd);
+            errno = EEXIST;
+            return -1;
+        }
+        unlink(path);
+    }
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, 1)) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    v->listen_fd = fd;
+    return 0;
+}
+
+void versus_close(Versus *v) {
+    if (v->fd >= 0)
+        close(v->fd);
+    if (v->listen_fd >= 0) {
+        close(v->listen_fd);
+        unlink(v->path);
+    }
+    v->fd = v->listen_fd = -1;
+}
+
+static void disconnect(Versus *v) {
+    close(v->fd);
+    v->fd = -1;
+    v->n_out = 0;
+    memset(&v->peer, 0, sizeof(v->peer));
+    memset(&v->board, 0xff, sizeof(v->board));
+}
+
+// Sends everything queued in order, stopping at the first that would block
+static void flush(Versus *v) {
+    int sent = 0;
+    while (sent < v->n_out) {
+        ssize_t n = send(v->fd, v->out[sent], v->out_len[sent], MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            if (errno != EAGAIN)
+                disconnect(v);
+            break;
+        }
+        sent++;
+    }
+    if (v->fd < 0)
+        return;
+    v->n_out -= sent;
+    memmove(v->out, v->out[sent], v->n_out * sizeof(v->out[0]));
+    memmove(v->out_len, v->out_len + sent, v->n_out);
+}
+
+static void queue(Versus *v, uint8_t type, const void *msg, size_t len) {
+    if (v->fd < 0)
+        return;
+    // A peer this far behind isn't reading, the oldest goes
+    if (v->n_out == VERSUS_QUEUE) {
+        v->n_out--;
+        memmove(v->out, v->out[1], v->n_out * sizeof(v->out[0]));
+        memmove(v->out_len, v->out_len + 1, v->n_out);
+    }
+    v->out[v->n_out][0] = type;
+    if (len)
+        memcpy(v->out[v->n_out] + 1, msg, len);
+    v->out_len[v->n_out++] = 1 + len;
+    flush(v);
+}
+
+static void receive(Versus *v, uint8_t *buf, ssize_t len) {
+    Peer *p = &v->peer;
+    switch (buf[0]) {
+    case MSG_HELLO:
+        break;
+    case MSG_PIECE: {
+        MsgPiece m;
+        if (len != 1 + sizeof(m))
+            return;
+        memcpy(&m, buf + 1, sizeof(m));
+        p->pieces = m.pieces;
+        p->cleared = m.cleared;
+        p->sent = m.sent;
+        break;
+    }
+    case MSG_GARBAGE: {
+        MsgGarbage m;
+        if (len != 1 + sizeof(m) || v->n_in == VERSUS_QUEUE)
+            return;
+        memcpy(&m, buf + 1, sizeof(m));
+        v->in[v->n_in++] = (IncomingGarbage) { m.lines, m.hole, m.time };
+        break;
+    }
+    case MSG_BOARD: {
+        MsgBoard m;
+        if (len != 1 + sizeof(m))
+            return;
+        memcpy(&m, buf + 1, sizeof(m));
+        for (int i = 0; i < BOARD_HEIGHT * BOARD_WIDTH; i++)
+            p->colors[i / BOARD_WIDTH][i % BOARD_WIDTH] = (m.cells[i / 2] >> (i % 2 * 4)) & 15;
+        p->pending = m.pending;
+        p->version++;
+        break;
+    }
+    case MSG_LOST:
+        p->lost = 1;
+        break;
+    }
+}
+
+void versus_poll(Versus *v) {
+    if (v->fd < 0 && v->listen_fd >= 0) {
+        v->fd = accept(v->listen_fd, NULL, NULL);
+        if (v->fd < 0)
+            return;
+        fcntl(v->fd, F_SETFL, O_NONBLOCK);
+        v->peer.connected = 1;
+        MsgHello hello = { VERSUS_VERSION };
+        queue(v, MSG_HELLO, &hello, sizeof(hello));
+    }
+    if (v->fd < 0)
+        return;
+
+    flush(v);
+    uint8_t buf[MSG_MAX + 1];
+    ssize_t n;
+    while (v->fd >= 0 && (n = recv(v->fd, buf, sizeof(buf), MSG_DONTWAIT)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                disconnect(v);
+            return;
+        }
+        receive(v, buf, n);
+    }
+    // 0 is an orderly shutdown
+    if (v->fd >= 0)
+        disconnect(v);
+}
+
+void versus_garbage(Versus *v, int8_t lines, uint64_t time) {
+    MsgGarbage m = { lines, rng_next(&v->rng) % BOARD_WIDTH, time };
+    queue(v, MSG_GARBAGE, &m, sizeof(m));
+}
+
+void versus_piece(Versus *v, int pieces, int cleared, int sent) {
+    MsgPiece m = { pieces, cleared, sent };
+    queue(v, MSG_PIECE, &m, sizeof(m));
+}
+
+void versus_board(Versus *v, Board *board, Piece *p, int pending) {
+    MsgBoard m = { .pending = pending > 255 ? 255 : pending };
+    for (int i = 0; i < BOARD_HEIGHT * BOARD_WIDTH; i++) {
+        int8_t c = board->colors[i / BOARD_WIDTH][i % BOARD_WIDTH];
+        if (!(board->rows[i / BOARD_WIDTH] & (1 << i % BOARD_WIDTH)))
+            c = 0;
+        m.cells[i / 2] |= c << (i % 2 * 4);
+    }
+    for (int8_t i = 0; i < 4; i++) {
+        int y = p->coords[i][1];
+        int x = p->coords[i][0];
+        if (y >= 0 && y < BOARD_HEIGHT) {
+            int cell = y * BOARD_WIDTH + x;
+            m.cells[cell / 2] = (m.cells[cell / 2] & ~(15 << (cell % 2 * 4))) | (p->type + 1) << (cell % 2 * 4);
+        }
+    }
+    if (v->fd < 0 || !memcmp(&m, &v->board, sizeof(m)))
+        return;
+    v->board = m;
+    queue(v, MSG_BOARD, &m, sizeof(m));
+}
+
+void versus_lost(Versus *v) {
+    queue(v, MSG_LOST, NULL, 0);
+}
+
+void versus_reset(Versus *v) {
+    v->peer.lost = 0;
+    v->n_in = 0;
+}
@@ -0,0 +1,87 @@
+// Core rule checks, run with make check
+#include <stdio.h>
+#include "core.h"
+#include "timing.h"
+
+static int failed;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failed = 1; \
+    } \
+} while (0)
+
+static void tap(GameState *s, int8_t key, uint64_t time) {
+    core_input(s, key, 1, time);
+    core_input(s, key, 0, time + NS_PER_MS);
+}
+
+// 20G with lock delay, so the piece is on the stack as soon as it spawns
+static void start(GameState *s, uint32_t lock_resets) {
+    Config config = { .das = 100, .lock = 500, .lock_resets = lock_resets, .level = 1, .levels = 1 };
+    core_init(s, &config, 1);
+    core_start(s);
+}
+
+// Hold is refused after the first one, and pressing it again must not give
+// the grounded piece a fresh lock delay
+static void test_hold_spam() {
+    GameState s;
+    start(&s, 15);
+    tap(&s, HOLD, 10 * NS_PER_MS);
+    CHECK(s.holds == 1);
+    CHECK(s.grounded);
+    uint64_t landed = s.lock_start;
+
+    for (uint64_t t = 100; t < 2000; t += 100) {
+        core_advance(&s, t * NS_PER_MS);
+        if (s.pieces)
+            break;
+        tap(&s, HOLD, t * NS_PER_MS);
+    }
+    CHECK(s.holds == 1);
+    CHECK(s.pieces == 1);
+    CHECK(s.time <= landed + 600 * NS_PER_MS);
+}
+
+// In versus a hold that brings a piece out inside the stack tops out, on
+// its own the game carries on
+static void test_hold_top_out() {
+    for (int8_t versus = 0; versus < 2; versus++) {
+        GameState s;
+        start(&s, 15);
+        s.versus = versus;
+        for (int8_t y = 0; y <= SPAWN_Y + 1; y++)
+            s.board.rows[y] = FULL_ROW;
+        tap(&s, HOLD, 10 * NS_PER_MS);
+        CHECK(s.holds == 1);
+        CHECK(s.topped_out == versus);
+        CHECK(s.done == versus);
+        CHECK(!versus || s.end_time == 10 * NS_PER_MS);
+    }
+}
+
+// Moves on the ground restart lock delay up to lock_resets times
+static void test_lock_resets() {
+    GameState s;
+    start(&s, 3);
+
+    for (int i = 1; i <= 3; i++)
+        tap(&s, i & 1 ? LEFT : RIGHT, i * 300 * NS_PER_MS);
+    CHECK(s.resets == 3);
+    CHECK(!s.pieces);
+    tap(&s, LEFT, 1200 * NS_PER_MS);
+    CHECK(!s.pieces);
+    core_advance(&s, 1400 * NS_PER_MS);
+    CHECK(s.pieces == 1);
+}
+
+int main() {
+    test_hold_spam();
+    test_hold_top_out();
+    test_lock_resets();
+    if (!failed)
+        printf("ok\n");
+    return failed;
+}
@@ -0,0 +1,340 @@
+// Runs seeded games or replays across every core and sums up the results
+// Jobs are split evenly between workers up front, a worker that runs out
+// steals half of what is left from the next busy one
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bot.h"
+#include "core.h"
+#include "replay.h"
+#include "timing.h"
+
+// Seeded games give up here if they never reach the goal
+#define MAX_PIECES 1000
+// Gap between simulated key events
+#define KEY_GAP (10 * NS_PER_MS)
+
+typedef struct Job {
+    const char *path;
+    uint32_t seed;
+} Job;
+
+typedef struct Result {
+    // 1 if a replay reproduced its recorded result, -1 if it couldn't be read
+    int8_t ok;
+    int8_t done;
+    int pieces;
+    int cleared;
+    int keys;
+    int holds;
+    uint64_t time;
+} Result;
+
+struct Pool;
+
+typedef struct Worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    // Jobs [head, tail) are still to do
+    long head;
+    long tail;
+    struct Pool *pool;
+} Worker;
+
+typedef struct Pool {
+    Job *jobs;
+    Result *results;
+    Worker *workers;
+    int n_workers;
+    Config config;
+    int8_t use_bot;
+} Pool;
+
+// Column heights, holes and bumpiness of the settled board, higher is better
+static int evaluate(Board *board, int cleared) {
+    int height[BOARD_WIDTH] = { 0 };
+    int holes = 0;
+    for (int8_t y = BOARD_HEIGHT - 1; y >= 0; y--) {
+        for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+            if (board->rows[y] & (1 << x)) {
+                if (!height[x])
+                    height[x] = y + 1;
+            } else if (height[x]) {
+                holes++;
+            }
+        }
+    }
+
+    int total = 0;
+    int bump = 0;
+    for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+        total += height[x];
+        if (x)
+            bump += abs(height[x] - height[x - 1]);
+    }
+    return 76 * cleared - 51 * total - 36 * holes - 18 * bump;
+}
+
+static void tap(GameState *s, int8_t key, uint64_t *time) {
+    core_input(s, key, 1, *time += KEY_GAP);
+    core_input(s, key, 0, *time += KEY_GAP);
+}
+
+// Rotation keys for 0, 90, 180 and 270 degrees clockwise
+static const int8_t spins[4] = { -1, CW, FLIP, CCW };
+
+static void play(GameState *s, int8_t rot, int8_t shift, uint64_t *time) {
+    if (spins[rot] >= 0)
+        tap(s, spins[rot], time);
+    for (int8_t i = 0; i < abs(shift); i++)
+        tap(s, shift < 0 ? LEFT : RIGHT, time);
+    tap(s, HD, time);
+}
+
+// Tries every rotation and column on a copy of the game and plays the best
+static void play_piece(GameState *s, uint64_t *time) {
+    int best = 0;
+    int8_t best_rot = 0;
+    int8_t best_shift = 0;
+    int8_t found = 0;
+
+    for (int8_t rot = 0; rot < 4; rot++) {
+        for (int8_t shift = -BOARD_WIDTH / 2; shift <= BOARD_WIDTH / 2; shift++) {
+            GameState copy = *s;
+            uint64_t t = *time;
+            play(&copy, rot, shift, &t);
+            int score = evaluate(&copy.board, copy.cleared - s->cleared);
+            if (!found || score > best) {
+                best = score;
+                best_rot = rot;
+                best_shift = shift;
+                found = 1;
+            }
+        }
+    }
+    play(s, best_rot, best_shift, time);
+}
+
+// Plays the bot's placements at the pace it thinks of them
+static void play_bot(GameState *s, Bot *bot) {
+    uint64_t time = 0;
+    BotMove move;
+    while (!s->done && s->pieces < MAX_PIECES && bot_think(bot, s, &move)) {
+        for (int i = 0; i < move.n; i++)
+            core_input(s, move.ev[i].key, move.ev[i].pressed, time + move.ev[i].time);
+        time = s->time + KEY_GAP;
+    }
+}
+
+static void run_job(Pool *pool, Bot *bot, long i) {
+    Job *job = &pool->jobs[i];
+    Result *res = &pool->results[i];
+    GameState s;
+
+    if (job->path) {
+        Replay r;
+        if (replay_load(&r, job->path)) {
+            res->ok = -1;
+            return;
+        }
+        res->ok = replay_run(&r, &s);
+        replay_free(&r);
+    } else {
+        core_init(&s, &pool->config, job->seed);
+        core_start(&s);
+        uint64_t time = 0;
+        if (bot)
+            play_bot(&s, bot);
+        else while (!s.done && s.pieces < MAX_PIECES
+          && !check_collide(&s.board, s.curr.x, s.curr.y, s.curr.type, s.curr.rot))
+            play_piece(&s, &time);
+        res->ok = 1;
+    }
+
+    res->done = s.done;
+    res->pieces = s.pieces;
+    res->cleared = s.cleared;
+    res->keys = s.keys;
+    res->holds = s.holds;
+    res->time = s.done ? s.end_time : s.time;
+}
+
+// Moves the back half of another worker's jobs over, 0 if all are empty
+static int steal(Worker *self) {
+    Pool *pool = self->pool;
+    int me = self - pool->workers;
+    for (int i = 1; i < pool->n_workers; i++) {
+        Worker *victim = &pool->workers[(me + i) % pool->n_workers];
+        pthread_mutex_lock(&victim->lock);
+        long left = victim->tail - victim->head;
+        if (left > 0) {
+            long take = (left + 1) / 2;
+            victim->tail -= take;
+            pthread_mutex_lock(&self->lock);
+            self->head = victim->tail;
+            self->tail = victim->tail + take;
+            pthread_mutex_unlock(&self->lock);
+            pthread_mutex_unlock(&victim->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    Worker *self = arg;
+
+    // The pool already has a thread per core, so each bot thinks on one
+    Bot bot;
+    int8_t use_bot = 0;
+    if (self->pool->use_bot) {
+        Config config = self->pool->config;
+        config.bot_threads = 1;
+        use_bot = !bot_init(&bot, &config);
+    }
+
+    while (1) {
+        pthread_mutex_lock(&self->lock);
+        long i = self->head < self->tail ? self->head++ : -1;
+        pthread_mutex_unlock(&self->lock);
+
+        if (i >= 0)
+            run_job(self->pool, use_bot ? &bot : NULL, i);
+        else if (!steal(self))
+            break;
+    }
+    if (use_bot)
+        bot_free(&bot);
+    return NULL;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [-j threads] [-n games] [-s seed] [-b] [-v] [replay...]\n"
+        "Plays n seeded games with a greedy placer, or the bot with -b, or\n"
+        "checks the given replays\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long n = 1000;
+    uint32_t seed = 1;
+    int8_t verbose = 0;
+    int8_t use_bot = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:n:s:bv")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'n':
+            n = atol(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            use_bot = 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc)
+        n = argc - optind;
+    if (threads < 1 || n < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Pool pool = { 0 };
+    core_defaults(&pool.config);
+    bot_defaults(&pool.config);
+    pool.use_bot = use_bot;
+    pool.jobs = calloc(n, sizeof(Job));
+    pool.results = calloc(n, sizeof(Result));
+    pool.workers = calloc(threads, sizeof(Worker));
+    pool.n_workers = threads;
+    if (!pool.jobs || !pool.results || !pool.workers) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (long i = 0; i < n; i++) {
+        if (optind < argc)
+            pool.jobs[i].path = argv[optind + i];
+        else
+            pool.jobs[i].seed = seed + i;
+    }
+
+    uint64_t start = get_ns();
+    for (int i = 0; i < threads; i++) {
+        Worker *w = &pool.workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->head = n * i / threads;
+        w->tail = n * (i + 1) / threads;
+        w->pool = &pool;
+    }
+    for (int i = 0; i < threads; i++)
+        pthread_create(&pool.workers[i].thread, NULL, worker_main, &pool.workers[i]);
+    for (int i = 0; i < threads; i++)
+        pthread_join(pool.workers[i].thread, NULL);
+    uint64_t elapsed = get_ns() - start;
+
+    long finished = 0, failed = 0, mismatched = 0;
+    long pieces = 0, cleared = 0, keys = 0, holds = 0;
+    uint64_t total = 0, best = UINT64_MAX, worst = 0;
+    for (long i = 0; i < n; i++) {
+        Result *r = &pool.results[i];
+        if (verbose) {
+            if (pool.jobs[i].path)
+                printf("%s", pool.jobs[i].path);
+            else
+                printf("seed %u", pool.jobs[i].seed);
+            printf(": %s%d pieces, %d lines, %d keys, %d holds, %.3fs\n",
+                r->ok < 0 ? "unreadable, " : r->ok ? "" : "MISMATCH, ",
+                r->pieces, r->cleared, r->keys, r->holds, (double) r->time / NS_PER_SEC);
+        }
+        if (r->ok < 0) {
+            failed++;
+            continue;
+        }
+        mismatched += !r->ok;
+        pieces += r->pieces;
+        cleared += r->cleared;
+        keys += r->keys;
+        holds += r->holds;
+        if (r->done) {
+            finished++;
+            total += r->time;
+            if (r->time < best)
+                best = r->time;
+            if (r->time > worst)
+                worst = r->time;
+        }
+    }
+
+    printf("%ld games on %d threads in %.3fs, %ld finished, %ld mismatched, %ld unreadable\n",
+        n, threads, (double) elapsed / NS_PER_SEC, finished, mismatched, failed);
+    printf("%ld pieces, %ld lines, %ld holds, %.3f KPP\n",
+        pieces, cleared, holds, pieces ? (double) keys / pieces : 0.0);
+    if (finished)
+        printf("time mean %.3fs, best %.3fs, worst %.3fs\n",
+            (double) total / finished / NS_PER_SEC,
+            (double) best / NS_PER_SEC, (double) worst / NS_PER_SEC);
+
+    for (int i = 0; i < threads; i++)
+        pthread_mutex_destroy(&pool.workers[i].lock);
+    free(pool.jobs);
+    free(pool.results);
+    free(pool.workers);
+    return mismatched || failed;
+}
@@ -0,0 +1,66 @@
+// Emits the finesse_moves and finesse_clear_row tables declared in finesse.h
+// Searches every piece from spawn on an empty board without soft drop and
+// keeps the cheapest way to each rotation and column, plus the lowest row
+// any of those moves passes through
+#include <stdio.h>
+#include "finesse.h"
+
+int main() {
+    static Search s;
+    static Board board;
+    int8_t clear_row[BAG_SZ];
+
+    printf("// Generated by tools/gen_finesse.c, do not edit\n");
+    printf("#include \"finesse.h\"\n\n");
+    printf("const FinesseMove finesse_moves[BAG_SZ][4][BOARD_WIDTH] = {\n");
+
+    for (int8_t type = 0; type < BAG_SZ; type++) {
+        Piece start;
+        gen_piece(&start, type);
+        search_run(&s, &board, &start, 0);
+
+        // Cells visited on the way matter too, a spin passes through its
+        // kick tests so leave room for those below the lowest state reached
+        clear_row[type] = ARR_HEIGHT;
+        for (int i = 0; i < s.n; i++) {
+            Piece p;
+            search_piece(&s, s.order[i], &p);
+            for (int8_t j = 0; j < 4; j++)
+                if (p.coords[j][1] - 2 < clear_row[type])
+                    clear_row[type] = p.coords[j][1] - 2;
+        }
+
+        printf("    {\n");
+        for (int8_t rot = 0; rot < 4; rot++) {
+            printf("        {\n");
+            for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+                int16_t best = -1;
+                for (int i = 0; i < s.n && best < 0; i++) {
+                    Piece p;
+                    search_piece(&s, s.order[i], &p);
+                    if (p.x == x && p.rot == rot)
+                        best = s.order[i];
+                }
+
+                int8_t keys[SEARCH_MAX_PATH] = { 0 };
+                int8_t len = best < 0 ? -1 : search_path(&s, best, keys);
+                int8_t y = best < 0 ? 0 : best / BOARD_WIDTH % ARR_HEIGHT;
+                printf("            { %d, %d, {", y, len);
+                for (int8_t i = 0; i < len; i++)
+                    printf(" %d,", keys[i]);
+                if (len <= 0)
+                    printf(" 0");
+                printf(" } },\n");
+            }
+            printf("        },\n");
+        }
+        printf("    },\n");
+    }
+    printf("};\n\n");
+
+    printf("const int8_t finesse_clear_row[BAG_SZ] = {");
+    for (int8_t type = 0; type < BAG_SZ; type++)
+        printf(" %d,", clear_row[type] < 0 ? 0 : clear_row[type]);
+    printf(" };\n");
+    return 0;
+}
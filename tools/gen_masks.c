@@ -0,0 +1,51 @@
+// Emits the collide_masks table declared in board.h
+// For every piece, rotation and centre column it works out which centre
+// rows keep the piece inside the matrix and the row masks shifted to that
+// column, so check_collide is a range check and one masked compare
+#include <stdio.h>
+#include "board.h"
+
+int main() {
+    printf("// Generated by tools/gen_masks.c, do not edit\n");
+    printf("#include \"board.h\"\n\n");
+    printf("const CollideMask collide_masks[BAG_SZ][4][BOARD_WIDTH] = {\n");
+
+    for (int8_t type = 0; type < BAG_SZ; type++) {
+        printf("    {\n");
+        for (int8_t rot = 0; rot < 4; rot++) {
+            int8_t min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+            for (int8_t i = 0; i < 4; i++) {
+                int8_t x = pieces[type][rot][i][0];
+                int8_t y = pieces[type][rot][i][1];
+                if (x < min_x) min_x = x;
+                if (x > max_x) max_x = x;
+                if (y < min_y) min_y = y;
+                if (y > max_y) max_y = y;
+            }
+
+            printf("        {\n");
+            for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+                uint16_t rows[4] = { 0 };
+                // Board row of a mino is y - offset, so the lowest row is
+                // y - max_y and the highest is y - min_y
+                int8_t lo = max_y;
+                int8_t hi = ARR_HEIGHT - 1 + min_y;
+
+                if (x + min_x < 0 || x + max_x >= BOARD_WIDTH) {
+                    lo = 1;
+                    hi = 0;
+                } else {
+                    for (int8_t i = 0; i < 4; i++)
+                        rows[max_y - pieces[type][rot][i][1]] |= 1 << (x + pieces[type][rot][i][0]);
+                }
+
+                printf("            { { 0x%03x, 0x%03x, 0x%03x, 0x%03x }, %2d, %2d, %d },\n",
+                       rows[0], rows[1], rows[2], rows[3], lo, hi, max_y);
+            }
+            printf("        },\n");
+        }
+        printf("    },\n");
+    }
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Stand-in opponent for versus mode: sends garbage on a fixed interval and
+// reports how long the game's garbage took to arrive
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "perf.h"
+#include "timing.h"
+#include "versus.h"
+
+int main(int argc, char **argv) {
+    int lines = 1;
+    int interval = 1000;
+    int seconds = 30;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:i:t:")) != -1) {
+        switch (opt) {
+        case 'g':
+            lines = atoi(optarg);
+            break;
+        case 'i':
+            interval = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        default:
+            optind = argc + 1;
+        }
+    }
+    if (optind != argc - 1 || interval <= 0) {
+        fprintf(stderr, "Usage: %s [-g lines] [-i ms] [-t seconds] SOCKET\n", argv[0]);
+        fprintf(stderr, "Sends lines of garbage every ms until seconds pass or the game leaves\n");
+        return 1;
+    }
+
+    static Versus v;
+    if (versus_open(&v, argv[optind])) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    static Hist latency;
+    static Board board;
+    Piece piece;
+    gen_piece(&piece, 0);
+    int sent = 0;
+    int8_t was_connected = 0;
+    uint64_t end = get_ns() + (uint64_t) seconds * NS_PER_SEC;
+    uint64_t next = 0;
+    uint32_t boards = 0;
+    int8_t lost = 0;
+
+    for (uint64_t now = get_ns(); now < end; now = get_ns()) {
+        versus_poll(&v);
+        for (int i = 0; i < v.n_in; i++)
+            hist_add(&latency, now > v.in[i].time ? now - v.in[i].time : 0);
+        v.n_in = 0;
+
+        if (!v.peer.connected) {
+            if (was_connected)
+                break;
+        } else {
+            if (!was_connected)
+                next = now;
+            was_connected = 1;
+            if (now >= next) {
+                versus_garbage(&v, lines, now);
+                sent += lines;
+                versus_piece(&v, sent, 0, sent);
+                versus_board(&v, &board, &piece, 0);
+                next += (uint64_t) interval * NS_PER_MS;
+            }
+        }
+        boards = v.peer.version;
+        lost |= v.peer.lost;
+
+        struct timespec ts = { 0, NS_PER_MS };
+        nanosleep(&ts, NULL);
+    }
+    versus_close(&v);
+
+    printf("sent %d lines, received %d boards%s\n", sent, boards, lost ? ", the game topped out" : "");
+    printf("garbage received %llu, latency p50 %.3fms p99 %.3fms max %.3fms\n",
+        (unsigned long long) latency.n,
+        (double) hist_percentile(&latency, 0.5) / NS_PER_MS,
+        (double) hist_percentile(&latency, 0.99) / NS_PER_MS,
+        (double) latency.max / NS_PER_MS);
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Watches a game published with tetty --spectate NAME, from another terminal
+// Waits for the game to appear and follows it across resets, q quits
+#include <curses.h>
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "draw.h"
+#include "spectate.h"
+#include "timing.h"
+
+// The same layout as the game itself
+#define RIGHT_MARGIN 46
+
+static void draw_frame(SpectateFrame *f, Panel *board_win, Panel *queue_win, Panel *hold_win,
+                       Panel *key_win, Panel *stat_win) {
+    // Versions restart with every game
+    Board board = { .version = f->board_version ^ f->game << 20 };
+    memcpy(board.rows, f->rows, sizeof(f->rows));
+    memcpy(board.colors, f->colors, sizeof(f->colors));
+    Piece p;
+    gen_piece(&p, f->type);
+    p.rot = f->rot;
+    p.x = f->x;
+    p.y = f->y;
+
+    draw_board(board_win, &board, &p, CLEAR_GOAL - f->cleared, f->done);
+    draw_queue(queue_win, f->queue, 0);
+    draw_hold(hold_win, f->hold, f->hold_used);
+    draw_keys(key_win, f->inputs);
+    draw_stats(stat_win, f->time, f->pieces, f->keys, f->holds, NULL);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NAME\n", argv[0]);
+        return 1;
+    }
+    const char *name = argv[1];
+
+    setlocale(LC_ALL, "");
+    init_curses();
+
+    Panel board_win, queue_win, hold_win, key_win, stat_win;
+    panel_init(&board_win, BOARD_HEIGHT, BOARD_WIDTH * 2, 0, RIGHT_MARGIN);
+    panel_init(&queue_win, 15, 4 * 2, 0, RIGHT_MARGIN + BOARD_WIDTH * 2 + 2);
+    panel_init(&hold_win, 2, 4 * 2, 1, 36);
+    panel_init(&key_win, 7, 38, 3, 0);
+    panel_init(&stat_win, 5, 14, BOARD_HEIGHT + 1, RIGHT_MARGIN + 3);
+
+    SpectateShm *shm = NULL;
+    SpectateFrame f;
+    uint32_t frame = 0;
+    uint32_t game = 0;
+    Scheduler sched;
+    sched_init(&sched, NS_PER_SEC / FPS);
+
+    while (getch() != 'q') {
+        if (shm && !__atomic_load_n(&shm->live, __ATOMIC_ACQUIRE)) {
+            spectate_detach(shm);
+            shm = NULL;
+        }
+        if (!shm) {
+            shm = spectate_attach(name);
+            if (shm) {
+                draw_clear();
+                draw_gui(RIGHT_MARGIN - 1, 0);
+                draw_text(11, 0, "Watching");
+                // Force a full redraw
+                frame = game = UINT32_MAX;
+            } else {
+                draw_text(11, 0, "Waiting for the game to start");
+            }
+        }
+
+        if (shm && spectate_read(shm, &f) && (f.frame != frame || f.game != game)) {
+            frame = f.frame;
+            game = f.game;
+            draw_frame(&f, &board_win, &queue_win, &hold_win, &key_win, &stat_win);
+            draw_flush();
+        }
+        sched_wait(&sched, STDIN_FILENO);
+    }
+
+    if (shm)
+        spectate_detach(shm);
+    panel_free(&board_win);
+    panel_free(&queue_win);
+    panel_free(&hold_win);
+    panel_free(&key_win);
+    panel_free(&stat_win);
+    endwin();
+    return 0;
+}
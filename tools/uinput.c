@@ -0,0 +1,119 @@
+// Virtual keyboard for trying the evdev backend without touching a real one
+// Every argument is a key to tap, or key:ms to hold it down for that long,
+// played in order with a gap between them
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+// Time for tetty to find the new device before anything is typed
+#define SETTLE_MS 500
+#define GAP_MS 50
+
+typedef struct Key {
+    const char *name;
+    int code;
+} Key;
+
+static const Key keys[] = {
+    { "left", KEY_LEFT },
+    { "right", KEY_RIGHT },
+    { "down", KEY_DOWN },
+    { "up", KEY_UP },
+    { "space", KEY_SPACE },
+    { "shift", KEY_LEFTSHIFT },
+    { "a", KEY_A },
+    { "c", KEY_C },
+    { "d", KEY_D },
+    { "p", KEY_P },
+    { "q", KEY_Q },
+    { "r", KEY_R },
+    { "s", KEY_S },
+    { "x", KEY_X },
+    { "z", KEY_Z },
+};
+
+#define NKEYS (int) (sizeof(keys) / sizeof(keys[0]))
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, ms % 1000 * 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+static void emit(int fd, int type, int code, int value) {
+    struct input_event ev = { 0 };
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    if (write(fd, &ev, sizeof(ev)) != sizeof(ev))
+        perror("write");
+}
+
+static void key(int fd, int code, int pressed) {
+    emit(fd, EV_KEY, code, pressed);
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+}
+
+static int lookup(const char *name, size_t len) {
+    for (int i = 0; i < NKEYS; i++)
+        if (strlen(keys[i].name) == len && !strncmp(keys[i].name, name, len))
+            return keys[i].code;
+    return -1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s KEY[:MS]...\nKeys:", argv[0]);
+        for (int i = 0; i < NKEYS; i++)
+            fprintf(stderr, " %s", keys[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("/dev/uinput");
+        return 1;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    for (int i = 0; i < NKEYS; i++)
+        ioctl(fd, UI_SET_KEYBIT, keys[i].code);
+
+    struct uinput_setup setup = { 0 };
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x7e77;
+    setup.id.product = 0x0001;
+    strcpy(setup.name, "tetty virtual keyboard");
+    if (ioctl(fd, UI_DEV_SETUP, &setup) || ioctl(fd, UI_DEV_CREATE)) {
+        perror("uinput");
+        close(fd);
+        return 1;
+    }
+    sleep_ms(SETTLE_MS);
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        char *colon = strchr(argv[i], ':');
+        size_t len = colon ? (size_t) (colon - argv[i]) : strlen(argv[i]);
+        int code = lookup(argv[i], len);
+        if (code < 0) {
+            fprintf(stderr, "Unknown key %s\n", argv[i]);
+            status = 1;
+            break;
+        }
+        key(fd, code, 1);
+        if (colon)
+            sleep_ms(atol(colon + 1));
+        key(fd, code, 0);
+        sleep_ms(GAP_MS);
+    }
+
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+    return status;
+}